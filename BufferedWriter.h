@@ -0,0 +1,121 @@
+/**************************************************************************************************
+*
+* \file BufferedWriter.h
+* \brief C++ Training - Fast formatted output to stdout, shared by the STL programming tasks
+*
+* Copyright (C) 2015-2022 Klaus Iglberger - All Rights Reserved
+*
+* This file is part of the C++ training by Klaus Iglberger. The file may only be used in the
+* context of the C++ training or with explicit agreement by Klaus Iglberger.
+*
+**************************************************************************************************/
+
+#ifndef BUFFERED_WRITER_H
+#define BUFFERED_WRITER_H
+
+#include <array>
+#include <cerrno>
+#include <charconv>
+#include <cstddef>
+#include <cstdio>
+#include <iostream>
+#include <type_traits>
+
+#include <unistd.h>
+
+
+// The integral types that std::ostream writes as characters or, for bool, as 0 or 1
+template< typename T >
+struct IsCharacter
+   : std::bool_constant< std::is_same<T,char>::value || std::is_same<T,signed char>::value ||
+                         std::is_same<T,unsigned char>::value || std::is_same<T,bool>::value > {};
+
+
+// Formats numbers with std::to_chars into a large local buffer and hands each full buffer to the
+// operating system with a single write() call, bypassing the per-value locale and stream machinery
+// of std::cout. The output is byte-identical to streaming the values through a default std::cout:
+// character types (including int8_t) are written as characters and bools as 0 or 1.
+class BufferedWriter
+{
+ public:
+   BufferedWriter()
+   {
+      // Keep the ordering with everything already written through std::cout
+      std::cout.flush();
+      std::fflush( stdout );
+   }
+
+   BufferedWriter( BufferedWriter const& ) = delete;
+   BufferedWriter& operator=( BufferedWriter const& ) = delete;
+
+   ~BufferedWriter() { flush(); }
+
+   BufferedWriter& operator<<( char c )
+   {
+      reserve( 1U );
+      buffer_[size_++] = c;
+      return *this;
+   }
+
+   BufferedWriter& operator<<( signed char c )   { return *this << static_cast<char>( c ); }
+   BufferedWriter& operator<<( unsigned char c ) { return *this << static_cast<char>( c ); }
+   BufferedWriter& operator<<( bool value )      { return *this << ( value ? '1' : '0' ); }
+
+   BufferedWriter& operator<<( char const* s )
+   {
+      for( ; *s != '\0'; ++s ) {
+         *this << *s;
+      }
+      return *this;
+   }
+
+   template< typename Integer
+           , typename = std::enable_if_t< std::is_integral<Integer>::value && !IsCharacter<Integer>::value > >
+   BufferedWriter& operator<<( Integer value )
+   {
+      reserve( maxNumberLength );
+      auto const result = std::to_chars( buffer_.data() + size_, buffer_.data() + buffer_.size(), value );
+      size_ = static_cast<std::size_t>( result.ptr - buffer_.data() );
+      return *this;
+   }
+
+   // Matches the default std::ostream formatting of doubles (%g with a precision of 6)
+   BufferedWriter& operator<<( double value )
+   {
+      reserve( maxNumberLength );
+      auto const result = std::to_chars( buffer_.data() + size_, buffer_.data() + buffer_.size(),
+                                         value, std::chars_format::general, 6 );
+      size_ = static_cast<std::size_t>( result.ptr - buffer_.data() );
+      return *this;
+   }
+
+   void flush()
+   {
+      char const* data = buffer_.data();
+      while( size_ > 0U ) {
+         ssize_t const written = ::write( STDOUT_FILENO, data, size_ );
+         if( written < 0 ) {
+            if( errno == EINTR ) continue;
+            break;
+         }
+         data  += written;
+         size_ -= static_cast<std::size_t>( written );
+      }
+      size_ = 0U;
+   }
+
+ private:
+   static constexpr std::size_t maxNumberLength = 32U;
+
+   void reserve( std::size_t length )
+   {
+      if( buffer_.size() - size_ < length ) {
+         flush();
+      }
+   }
+
+   std::array<char,std::size_t{1} << 16> buffer_;
+   std::size_t size_{ 0U };
+};
+
+#endif
@@ -20,29 +20,71 @@
 **************************************************************************************************/
 
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <cerrno>
+#include <charconv>
+#include <chrono>
+#include <climits>
+#include <cmath>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <deque>
+#include <future>
+#include <initializer_list>
 #include <iostream>
 #include <iterator>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <type_traits>
+#include <unordered_map>
+#include <utility>
 #include <vector>
 
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "BufferedWriter.h"
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+
 
 using Ints = std::vector<int>;
 
 
-void printToScreen( Ints const& ints )
+template< typename Range >
+void printToScreen( Range const& ints )
 {
-    auto print = [](const int& n) {std::cout << n << ' ';};
-    std::for_each(ints.begin(), ints.end(), print);
+    BufferedWriter out;
+    auto print = [&out](const auto& n) {out << n << ' ';};
+    std::for_each(std::begin(ints), std::end(ints), print);
 }
 
 
-void reverseOrder( Ints& ints )
+template< typename Range >
+void reverseOrder( Range& ints )
 {
-    std::reverse(ints.begin(), ints.end());
+    std::reverse(std::begin(ints), std::end(ints));
     printToScreen(ints);
 }
 
 
-void findFirstFive( Ints const& ints )
+template< typename Range >
+void findFirstFive( Range const& ints )
 {
     auto pos = std::find(std::begin(ints), std::end(ints), 5);
     if (pos != std::end(ints)){
@@ -53,42 +95,2149 @@ void findFirstFive( Ints const& ints )
 }
 
 
-void countNumberOfFives( Ints const& ints )
+template< typename Range >
+void countNumberOfFives( Range const& ints )
 {
    size_t const quant = std::count(std::begin(ints), std::end(ints), 5);
    std::cout << "Number of elements found: " << quant;
 }
 
 
-void replaceAllFivesWithTwos( Ints& ints )
+template< typename Range >
+void replaceAllFivesWithTwos( Range& ints )
 {
    std::replace(std::begin(ints), std::end(ints), 5, 2);
     printToScreen(ints);
 }
 
 
-void sortInts( Ints& ints )
+// LSD radix sort for 32- and 64-bit integer keys. All digit histograms are built in a single
+// pre-pass, passes in which all elements share the same digit are skipped, and the scratch
+// buffer is kept between calls so repeated sorts do not reallocate.
+template< typename T >
+class RadixSorter
+{
+   static_assert( std::is_integral<T>::value && ( sizeof(T) == 4U || sizeof(T) == 8U ),
+                  "RadixSorter requires a 32- or 64-bit integer type" );
+
+   using Key = std::make_unsigned_t<T>;
+
+   static constexpr std::size_t digitBits = 8U;
+   static constexpr std::size_t buckets   = std::size_t{1} << digitBits;
+   static constexpr std::size_t passes    = sizeof(T) * CHAR_BIT / digitBits;
+
+   // Maps the value to an unsigned key with the same ordering (flips the sign bit of signed types)
+   static Key toKey( T value ) noexcept
+   {
+      Key const key = static_cast<Key>( value );
+      return std::is_signed<T>::value ? Key( key ^ ( Key{1} << ( sizeof(T) * CHAR_BIT - 1U ) ) ) : key;
+   }
+
+   static std::size_t digit( Key key, std::size_t pass ) noexcept
+   {
+      return static_cast<std::size_t>( key >> ( pass * digitBits ) ) & ( buckets - 1U );
+   }
+
+ public:
+   void sort( T* first, T* last )
+   {
+      std::size_t const n = static_cast<std::size_t>( last - first );
+      if( scratch_.size() < n ) {
+         scratch_.resize( n );
+      }
+      sort( first, last, scratch_.data() );
+   }
+
+   // Sorts with a caller-owned scratch buffer of at least last-first elements
+   static void sort( T* first, T* last, T* scratch )
+   {
+      std::size_t const n = static_cast<std::size_t>( last - first );
+      T const* const result = sortInto( first, n, scratch );
+      // After an odd number of passes the result lives in the scratch buffer
+      if( result != first ) {
+         std::copy( result, result + n, first );
+      }
+   }
+
+ private:
+   // Sorts the n values at 'data' and returns the buffer holding the result ('data' or 'scratch')
+   static T* sortInto( T* data, std::size_t n, T* scratch )
+   {
+      if( n < 2U ) return data;
+
+      std::array<std::array<std::size_t,buckets>,passes> counts{};
+      for( std::size_t i=0U; i<n; ++i ) {
+         Key const key = toKey( data[i] );
+         for( std::size_t pass=0U; pass<passes; ++pass ) {
+            ++counts[pass][digit( key, pass )];
+         }
+      }
+
+      T* src = data;
+      T* dst = scratch;
+
+      for( std::size_t pass=0U; pass<passes; ++pass )
+      {
+         auto& count = counts[pass];
+         if( count[digit( toKey( data[0] ), pass )] == n ) continue;
+
+         std::size_t offset = 0U;
+         for( auto& c : count ) {
+            std::size_t const tmp = c;
+            c = offset;
+            offset += tmp;
+         }
+
+         for( std::size_t i=0U; i<n; ++i ) {
+            dst[count[digit( toKey( src[i] ), pass )]++] = src[i];
+         }
+         std::swap( src, dst );
+      }
+
+      return src;
+   }
+
+   std::vector<T> scratch_;
+};
+
+
+// Below this size std::sort beats the fixed histogram overhead of the radix sort
+constexpr std::size_t radixSortThreshold = 1024U;
+
+
+template< typename T >
+void sequentialSort( T* first, T* last )
+{
+   if constexpr( std::is_integral<T>::value && ( sizeof(T) == 4U || sizeof(T) == 8U ) ) {
+      if( static_cast<std::size_t>( last - first ) >= radixSortThreshold ) {
+         thread_local RadixSorter<T> sorter;
+         sorter.sort(first, last);
+         return;
+      }
+   }
+   std::sort(first, last);
+}
+
+
+// As above, but with a caller-owned scratch buffer of last-first elements instead of a per-thread one
+template< typename T >
+void sequentialSort( T* first, T* last, T* scratch )
 {
-   std::sort(std::begin(ints), std::end(ints));
+   if constexpr( std::is_integral<T>::value && ( sizeof(T) == 4U || sizeof(T) == 8U ) ) {
+      if( static_cast<std::size_t>( last - first ) >= radixSortThreshold ) {
+         RadixSorter<T>::sort(first, last, scratch);
+         return;
+      }
+   }
+   std::sort(first, last);
+}
+
+
+// Fixed-size pool of worker threads shared by all parallel algorithms in this file
+class ThreadPool
+{
+ public:
+   explicit ThreadPool( std::size_t threads )
+   {
+      for( std::size_t i=0U; i<threads; ++i ) {
+         workers_.emplace_back( [this]{ run(); } );
+      }
+   }
+
+   ThreadPool( ThreadPool const& ) = delete;
+   ThreadPool& operator=( ThreadPool const& ) = delete;
+
+   ~ThreadPool()
+   {
+      {
+         std::lock_guard<std::mutex> lock( mutex_ );
+         stop_ = true;
+      }
+      ready_.notify_all();
+      for( auto& worker : workers_ ) {
+         worker.join();
+      }
+   }
+
+   std::size_t size() const noexcept { return workers_.size(); }
+
+   template< typename Task >
+   std::future<void> submit( Task&& task )
+   {
+      std::packaged_task<void()> job( std::forward<Task>( task ) );
+      std::future<void> result = job.get_future();
+      {
+         std::lock_guard<std::mutex> lock( mutex_ );
+         tasks_.push_back( std::move( job ) );
+      }
+      ready_.notify_one();
+      return result;
+   }
+
+ private:
+   void run()
+   {
+      for( ;; )
+      {
+         std::packaged_task<void()> job;
+         {
+            std::unique_lock<std::mutex> lock( mutex_ );
+            ready_.wait( lock, [this]{ return stop_ || !tasks_.empty(); } );
+            if( tasks_.empty() ) return;
+            job = std::move( tasks_.front() );
+            tasks_.pop_front();
+         }
+         job();
+      }
+   }
+
+   std::vector<std::thread> workers_;
+   std::deque<std::packaged_task<void()>> tasks_;
+   std::mutex mutex_;
+   std::condition_variable ready_;
+   bool stop_{ false };
+};
+
+
+ThreadPool& sharedThreadPool()
+{
+   static ThreadPool pool( std::max( 1U, std::thread::hardware_concurrency() ) );
+   return pool;
+}
+
+
+void waitAll( std::vector<std::future<void>>& futures )
+{
+   for( auto& f : futures ) {
+      f.get();
+   }
+   futures.clear();
+}
+
+
+// Merge path: returns how many elements of 'a' precede output position 'diag' when merging a and b
+template< typename T >
+std::size_t mergePathSplit( T const* a, std::size_t na, T const* b, std::size_t nb, std::size_t diag )
+{
+   std::size_t lo = diag > nb ? diag - nb : 0U;
+   std::size_t hi = std::min( diag, na );
+   while( lo < hi ) {
+      std::size_t const mid = lo + ( hi - lo ) / 2U;
+      if( b[diag - mid - 1U] < a[mid] ) {
+         hi = mid;
+      }
+      else {
+         lo = mid + 1U;
+      }
+   }
+   return lo;
+}
+
+
+// Queues 'parts' independent tasks that together merge [a,a+na) and [b,b+nb) into 'out'
+template< typename T >
+void parallelMerge( T const* a, std::size_t na, T const* b, std::size_t nb, T* out,
+                    std::size_t parts, ThreadPool& pool, std::vector<std::future<void>>& futures )
+{
+   std::size_t const total = na + nb;
+   for( std::size_t part=0U; part<parts; ++part )
+   {
+      std::size_t const diagBegin = total * part / parts;
+      std::size_t const diagEnd   = total * ( part + 1U ) / parts;
+      futures.push_back( pool.submit( [=]{
+         std::size_t const i0 = mergePathSplit( a, na, b, nb, diagBegin );
+         std::size_t const i1 = mergePathSplit( a, na, b, nb, diagEnd );
+         std::merge( a + i0, a + i1, b + ( diagBegin - i0 ), b + ( diagEnd - i1 ), out + diagBegin );
+      } ) );
+   }
+}
+
+
+// Below this size the cost of dispatching to the pool outweighs the parallel speedup
+constexpr std::size_t parallelSortCutoff = std::size_t{1} << 17;
+
+
+// Sorts equal chunks on the pool and then merges them pairwise, each merge split with merge path.
+// 'buffer' serves as the scratch space of the chunk sorts and then as the merge target, so no other
+// memory of the size of the input is needed. Returns the buffer that holds the result, either
+// 'data' or 'buffer'.
+template< typename T >
+T* parallelSortInto( T* data, std::size_t n, T* buffer, ThreadPool& pool )
+{
+   std::size_t const threads = pool.size();
+   std::size_t const chunks = std::min( threads, n / ( parallelSortCutoff / 4U ) );
+   std::vector<std::size_t> bounds( chunks + 1U );
+   for( std::size_t c=0U; c<=chunks; ++c ) {
+      bounds[c] = n * c / chunks;
+   }
+
+   std::vector<std::future<void>> futures;
+   for( std::size_t c=0U; c<chunks; ++c ) {
+      futures.push_back( pool.submit( [=]{ sequentialSort(data + bounds[c], data + bounds[c+1U], buffer + bounds[c]); } ) );
+   }
+   waitAll( futures );
+
+   T* src = data;
+   T* dst = buffer;
+
+   while( bounds.size() > 2U )
+   {
+      std::vector<std::size_t> merged{ 0U };
+      for( std::size_t r=0U; r+1U<bounds.size(); r+=2U )
+      {
+         std::size_t const first = bounds[r];
+         if( r + 2U < bounds.size() ) {
+            std::size_t const mid  = bounds[r+1U];
+            std::size_t const last = bounds[r+2U];
+            std::size_t const parts = std::max<std::size_t>( 1U, threads * ( last - first ) / n );
+            parallelMerge( src + first, mid - first, src + mid, last - mid, dst + first, parts, pool, futures );
+            merged.push_back( last );
+         }
+         else {
+            std::size_t const last = bounds[r+1U];
+            futures.push_back( pool.submit( [=]{ std::copy( src + first, src + last, dst + first ); } ) );
+            merged.push_back( last );
+         }
+      }
+      waitAll( futures );
+      bounds.swap( merged );
+      std::swap( src, dst );
+   }
+
+   return src;
+}
+
+
+// Sorts [first,last) using the caller-owned 'buffer' of last-first elements as the only scratch memory
+template< typename T >
+void parallelSort( T* first, T* last, T* buffer, ThreadPool& pool = sharedThreadPool() )
+{
+   std::size_t const n = static_cast<std::size_t>( last - first );
+   if( n < parallelSortCutoff || pool.size() < 2U ) {
+      sequentialSort(first, last, buffer);
+      return;
+   }
+
+   T const* const result = parallelSortInto( first, n, buffer, pool );
+   if( result != first ) {
+      std::copy( result, result + n, first );
+   }
+}
+
+
+template< typename T >
+void parallelSort( T* first, T* last, ThreadPool& pool = sharedThreadPool() )
+{
+   std::size_t const n = static_cast<std::size_t>( last - first );
+   if( n < parallelSortCutoff || pool.size() < 2U ) {
+      sequentialSort(first, last);
+      return;
+   }
+
+   std::vector<T> buffer( n );
+   parallelSort( first, last, buffer.data(), pool );
+}
+
+
+template< typename T >
+void parallelSort( std::vector<T>& values, ThreadPool& pool = sharedThreadPool() )
+{
+   std::size_t const n = values.size();
+   if( n < parallelSortCutoff || pool.size() < 2U ) {
+      sequentialSort(values.data(), values.data() + n);
+      return;
+   }
+
+   std::vector<T> buffer( n );
+   if( parallelSortInto( values.data(), n, buffer.data(), pool ) != values.data() ) {
+      values.swap( buffer );
+   }
+}
+
+
+template< typename Range >
+void sortInts( Range& ints )
+{
+   parallelSort(ints.data(), ints.data() + ints.size());
     printToScreen(ints);
 }
 
 
-void findAllTwos( Ints const& ints )
+template< typename Range >
+void findAllTwos( Range const& ints )
 {
     auto low = std::lower_bound(std::begin(ints), std::end(ints), 2);
     auto high = std::upper_bound(std::begin(ints), std::end(ints), 2);
-    std::cout << distance(low, high);
+    std::cout << std::distance(low, high);
 }
 
 
+// Read-only search index over sorted Ints that stores the keys in Eytzinger (BFS) order. The
+// search walks down the implicit tree without branches and prefetches the cache line holding the
+// descendants four levels ahead, so repeated queries against the same data mostly hit cache.
+class EytzingerIndex
+{
+ public:
+   explicit EytzingerIndex( Ints const& sorted )
+      : keys_( sorted.size() + 1U )
+      , height_( bitWidth( sorted.size() ) )
+      , missingFrom_( 2U * ( sorted.size() + 1U - ( std::size_t{1} << ( height_ > 0U ? height_ - 1U : 0U ) ) ) )
+   {
+      std::size_t i = 0U;
+      build( sorted, i, 1U );
+   }
+
+   std::size_t size() const noexcept { return keys_.size() - 1U; }
+
+   // Position of the first element not less than 'value' in the sorted order
+   std::size_t lower_bound( int value ) const noexcept
+   {
+      return rank( search( [value]( int key ){ return key < value; } ) );
+   }
+
+   // Position of the first element greater than 'value' in the sorted order
+   std::size_t upper_bound( int value ) const noexcept
+   {
+      return rank( search( [value]( int key ){ return key <= value; } ) );
+   }
+
+   std::size_t count( int value ) const noexcept
+   {
+      return count( value, value );
+   }
+
+   // Number of elements in the closed interval [low,high]. Both descents run in one loop, so their
+   // cache misses overlap instead of being paid one after the other.
+   std::size_t count( int low, int high ) const noexcept
+   {
+      if( low > high ) return 0U;
+
+      std::size_t const n = size();
+      int const* const keys = keys_.data();
+      std::size_t lo = 1U;
+      std::size_t hi = 1U;
+      // Both descents are at the same depth, so they leave the tree together, except that one of
+      // them may still have a node on a partially filled last level
+      while( lo <= n && hi <= n ) {
+#if defined(__GNUC__)
+         __builtin_prefetch( keys + std::min( 16U * lo, n ) );
+         __builtin_prefetch( keys + std::min( 16U * hi, n ) );
+#endif
+         lo = 2U * lo + static_cast<std::size_t>( keys[lo] < low );
+         hi = 2U * hi + static_cast<std::size_t>( keys[hi] <= high );
+      }
+      if( lo <= n ) lo = 2U * lo + static_cast<std::size_t>( keys[lo] < low );
+      if( hi <= n ) hi = 2U * hi + static_cast<std::size_t>( keys[hi] <= high );
+
+      return rank( settle( hi ) ) - rank( settle( lo ) );
+   }
+
+ private:
+   static std::size_t bitWidth( std::size_t x ) noexcept
+   {
+#if defined(__GNUC__)
+      return x == 0U ? 0U : 64U - static_cast<std::size_t>( __builtin_clzll( x ) );
+#else
+      std::size_t width = 0U;
+      for( ; x != 0U; x >>= 1U ) ++width;
+      return width;
+#endif
+   }
+
+   void build( Ints const& sorted, std::size_t& i, std::size_t k )
+   {
+      if( k < keys_.size() ) {
+         build( sorted, i, 2U * k );
+         keys_[k] = sorted[i++];
+         build( sorted, i, 2U * k + 1U );
+      }
+   }
+
+   // Sorted position of slot k, computed from its place in the tree instead of looked up in a
+   // table: in a perfect tree of 'height_' levels the node j of level d comes at in-order position
+   // (2j+1)*2^(height_-1-d) - 1, and every missing leaf of the last level before it shifts it by one.
+   // Slot 0 (no such element) maps to size().
+   std::size_t rank( std::size_t k ) const noexcept
+   {
+      if( k == 0U ) return size();
+      std::size_t const depth = bitWidth( k ) - 1U;
+      std::size_t const j = k - ( std::size_t{1} << depth );
+      std::size_t const perfect = ( ( 2U * j + 1U ) << ( height_ - 1U - depth ) ) - 1U;
+      return perfect > missingFrom_ ? perfect - ( perfect - missingFrom_ + 1U ) / 2U : perfect;
+   }
 
+   // Undoes the trailing right turns plus the final left turn of a finished descent
+   static std::size_t settle( std::size_t k ) noexcept
+   {
+      while( k & 1U ) {
+         k >>= 1U;
+      }
+      return k >> 1U;
+   }
 
+   // Returns the Eytzinger slot of the first key for which 'goRight' fails, or 0 if there is none
+   template< typename GoRight >
+   std::size_t search( GoRight goRight ) const noexcept
+   {
+      std::size_t const n = size();
+      int const* const keys = keys_.data();
+      std::size_t k = 1U;
+      while( k <= n ) {
+#if defined(__GNUC__)
+         __builtin_prefetch( keys + std::min( 16U * k, n ) );
+#endif
+         k = 2U * k + static_cast<std::size_t>( goRight( keys[k] ) );
+      }
+      return settle( k );
+   }
 
-int main()
+   Ints keys_;                // 1-based, slot 0 is unused
+   std::size_t height_;       // Number of levels of the tree
+   std::size_t missingFrom_;  // In-order position in the perfect tree of the first missing leaf
+};
+
+
+void findAllTwos( EytzingerIndex const& index )
+{
+    std::cout << index.count(2);
+}
+
+
+// Ints wrapper that remembers whether the data is sorted and lazily caches its minimum, maximum
+// and per-value counts. The caches are only touched by mutations through this interface, so
+// repeated queries on unchanged data neither re-sort nor rescan.
+class TrackedInts
 {
-   Ints ints{ 3, 6, 27, 5, 1, 8, 5, 4 };
+ public:
+   TrackedInts() = default;
+   TrackedInts( std::initializer_list<int> values ) : values_( values ) {}
+   explicit TrackedInts( Ints values ) : values_( std::move( values ) ) {}
+
+   Ints const& values() const noexcept { return values_; }
+   std::size_t size() const noexcept { return values_.size(); }
+   bool empty() const noexcept { return values_.empty(); }
+   int operator[]( std::size_t i ) const noexcept { return values_[i]; }
+   Ints::const_iterator begin() const noexcept { return values_.begin(); }
+   Ints::const_iterator end() const noexcept { return values_.end(); }
+
+   bool isSorted() const
+   {
+      if( sorted_ == Sortedness::unknown ) {
+         sorted_ = std::is_sorted(std::begin(values_), std::end(values_)) ? Sortedness::yes : Sortedness::no;
+      }
+      return sorted_ == Sortedness::yes;
+   }
+
+   // Precondition: !empty()
+   int min() const { updateMinMax(); return min_; }
+   int max() const { updateMinMax(); return max_; }
+
+   std::size_t count( int value ) const
+   {
+      if( !hasCounts_ && isSorted() ) {
+         auto const range = std::equal_range(std::begin(values_), std::end(values_), value);
+         return static_cast<std::size_t>( range.second - range.first );
+      }
+      if( !hasCounts_ ) {
+         for( int v : values_ ) {
+            ++counts_[v];
+         }
+         hasCounts_ = true;
+      }
+      auto const pos = counts_.find( value );
+      return pos != counts_.end() ? pos->second : 0U;
+   }
+
+   void set( std::size_t i, int value )
+   {
+      int const old = values_[i];
+      if( old == value ) return;
+      values_[i] = value;
+      sorted_ = Sortedness::unknown;
+      hasMinMax_ = false;
+      if( hasCounts_ ) {
+         decrementCount( old );
+         ++counts_[value];
+      }
+   }
+
+   void push_back( int value )
+   {
+      if( sorted_ == Sortedness::yes && !values_.empty() && value < values_.back() ) {
+         sorted_ = Sortedness::no;
+      }
+      values_.push_back( value );
+      if( hasMinMax_ ) {
+         min_ = std::min( min_, value );
+         max_ = std::max( max_, value );
+      }
+      if( hasCounts_ ) {
+         ++counts_[value];
+      }
+   }
+
+   // Reordering leaves the statistics untouched
+   void reverse()
+   {
+      std::reverse(std::begin(values_), std::end(values_));
+      sorted_ = Sortedness::unknown;
+   }
+
+   void sort()
+   {
+      if( isSorted() ) return;
+      parallelSort(values_);
+      sorted_ = Sortedness::yes;
+   }
+
+   void replace( int oldValue, int newValue )
+   {
+      if( oldValue == newValue || ( hasCounts_ && counts_.find( oldValue ) == counts_.end() ) ) return;
+      std::replace(std::begin(values_), std::end(values_), oldValue, newValue);
+      sorted_ = Sortedness::unknown;
+      hasMinMax_ = false;
+      if( hasCounts_ ) {
+         counts_[newValue] += counts_[oldValue];
+         counts_.erase( oldValue );
+      }
+   }
+
+ private:
+   enum class Sortedness { unknown, yes, no };
+
+   void updateMinMax() const
+   {
+      if( !hasMinMax_ ) {
+         if( isSorted() ) {
+            min_ = values_.front();
+            max_ = values_.back();
+         }
+         else {
+            auto const minmax = std::minmax_element(std::begin(values_), std::end(values_));
+            min_ = *minmax.first;
+            max_ = *minmax.second;
+         }
+         hasMinMax_ = true;
+      }
+   }
+
+   void decrementCount( int value )
+   {
+      auto const pos = counts_.find( value );
+      if( --pos->second == 0U ) {
+         counts_.erase( pos );
+      }
+   }
+
+   Ints values_;
+   mutable Sortedness sorted_{ Sortedness::unknown };
+   mutable bool hasMinMax_{ false };
+   mutable int min_{};
+   mutable int max_{};
+   mutable bool hasCounts_{ false };
+   mutable std::unordered_map<int,std::size_t> counts_;
+};
+
+
+void reverseOrder( TrackedInts& ints )
+{
+    ints.reverse();
+    printToScreen(ints);
+}
+
+
+void countNumberOfFives( TrackedInts const& ints )
+{
+   std::cout << "Number of elements found: " << ints.count(5);
+}
+
+
+void replaceAllFivesWithTwos( TrackedInts& ints )
+{
+   ints.replace(5, 2);
+    printToScreen(ints);
+}
+
+
+void sortInts( TrackedInts& ints )
+{
+   ints.sort();
+    printToScreen(ints);
+}
+
+
+void findAllTwos( TrackedInts const& ints )
+{
+    std::cout << ints.count(2);
+}
+
+
+std::size_t popcount( std::uint64_t word ) noexcept
+{
+#if defined(__GNUC__)
+   return static_cast<std::size_t>( __builtin_popcountll( word ) );
+#else
+   return std::bitset<64>( word ).count();
+#endif
+}
+
+
+// Compressed bitmap of 32-bit positions in the style of Roaring: the positions are grouped by their
+// upper 16 bits and every group is stored either as a sorted array (up to 4096 entries) or as a
+// plain 65536-bit bitmap, whichever is smaller.
+class RoaringBitmap
+{
+   static constexpr std::size_t maxArraySize = 4096U;
+   static constexpr std::size_t bitmapWords  = 1024U;
+
+   struct Container
+   {
+      std::uint16_t key{};
+      std::size_t cardinality{};
+      std::vector<std::uint16_t> array;  // Used while cardinality <= maxArraySize
+      std::vector<std::uint64_t> bits;   // Used otherwise
+
+      bool isBitmap() const noexcept { return !bits.empty(); }
+
+      bool contains( std::uint16_t low ) const
+      {
+         return isBitmap() ? ( bits[low >> 6U] >> ( low & 63U ) ) & 1U
+                           : std::binary_search( array.begin(), array.end(), low );
+      }
+
+      void add( std::uint16_t low )
+      {
+         if( isBitmap() ) {
+            std::uint64_t& word = bits[low >> 6U];
+            std::uint64_t const mask = std::uint64_t{1} << ( low & 63U );
+            cardinality += ( word & mask ) == 0U;
+            word |= mask;
+            return;
+         }
+         auto const pos = std::lower_bound( array.begin(), array.end(), low );
+         if( pos != array.end() && *pos == low ) return;
+         array.insert( pos, low );
+         if( ++cardinality > maxArraySize ) {
+            toBitmap();
+         }
+      }
+
+      void toBitmap()
+      {
+         bits.assign( bitmapWords, 0U );
+         for( std::uint16_t low : array ) {
+            bits[low >> 6U] |= std::uint64_t{1} << ( low & 63U );
+         }
+         std::vector<std::uint16_t>().swap( array );
+      }
+
+      // Converts a bitmap that became sparse back to an array
+      void normalize()
+      {
+         if( isBitmap() && cardinality <= maxArraySize ) {
+            array.reserve( cardinality );
+            forEach( [this]( std::uint16_t low ){ array.push_back( low ); } );
+            std::vector<std::uint64_t>().swap( bits );
+         }
+      }
+
+      template< typename Function >
+      void forEach( Function f ) const
+      {
+         if( !isBitmap() ) {
+            std::for_each( array.begin(), array.end(), f );
+            return;
+         }
+         for( std::size_t w=0U; w<bitmapWords; ++w ) {
+            for( std::uint64_t word=bits[w]; word!=0U; word&=word-1U ) {
+               std::uint64_t const lowest = word & ( ~word + 1U );
+               f( static_cast<std::uint16_t>( w * 64U + popcount( lowest - 1U ) ) );
+            }
+         }
+      }
+   };
+
+ public:
+   std::size_t cardinality() const noexcept
+   {
+      std::size_t total = 0U;
+      for( auto const& c : containers_ ) {
+         total += c.cardinality;
+      }
+      return total;
+   }
+
+   bool empty() const noexcept { return containers_.empty(); }
+
+   bool contains( std::uint32_t x ) const
+   {
+      Container const* const c = find( static_cast<std::uint16_t>( x >> 16U ) );
+      return c != nullptr && c->contains( static_cast<std::uint16_t>( x ) );
+   }
+
+   void add( std::uint32_t x )
+   {
+      std::uint16_t const key = static_cast<std::uint16_t>( x >> 16U );
+      auto pos = std::lower_bound( containers_.begin(), containers_.end(), key,
+                                   []( Container const& c, std::uint16_t k ){ return c.key < k; } );
+      if( pos == containers_.end() || pos->key != key ) {
+         pos = containers_.insert( pos, Container{} );
+         pos->key = key;
+      }
+      pos->add( static_cast<std::uint16_t>( x ) );
+   }
+
+   // Smallest position in the bitmap; precondition: !empty()
+   std::uint32_t minimum() const
+   {
+      std::uint32_t low = 0U;
+      Container const& c = containers_.front();
+      if( c.isBitmap() ) {
+         std::size_t w = 0U;
+         while( c.bits[w] == 0U ) ++w;
+         low = static_cast<std::uint32_t>( w * 64U + popcount( ( c.bits[w] & ( ~c.bits[w] + 1U ) ) - 1U ) );
+      }
+      else {
+         low = c.array.front();
+      }
+      return ( std::uint32_t{c.key} << 16U ) | low;
+   }
+
+   template< typename Function >
+   void forEach( Function f ) const
+   {
+      for( auto const& c : containers_ ) {
+         std::uint32_t const high = std::uint32_t{c.key} << 16U;
+         c.forEach( [&]( std::uint16_t low ){ f( high | low ); } );
+      }
+   }
+
+   friend RoaringBitmap operator&( RoaringBitmap const& a, RoaringBitmap const& b )
+   {
+      RoaringBitmap result;
+      auto i = a.containers_.begin();
+      auto j = b.containers_.begin();
+      while( i != a.containers_.end() && j != b.containers_.end() ) {
+         if( i->key < j->key ) { ++i; continue; }
+         if( j->key < i->key ) { ++j; continue; }
+         Container c = intersect( *i, *j );
+         if( c.cardinality > 0U ) {
+            result.containers_.push_back( std::move( c ) );
+         }
+         ++i;
+         ++j;
+      }
+      return result;
+   }
+
+   friend RoaringBitmap operator|( RoaringBitmap const& a, RoaringBitmap const& b )
+   {
+      RoaringBitmap result;
+      auto i = a.containers_.begin();
+      auto j = b.containers_.begin();
+      while( i != a.containers_.end() || j != b.containers_.end() ) {
+         if( j == b.containers_.end() || ( i != a.containers_.end() && i->key < j->key ) ) {
+            result.containers_.push_back( *i++ );
+         }
+         else if( i == a.containers_.end() || j->key < i->key ) {
+            result.containers_.push_back( *j++ );
+         }
+         else {
+            result.containers_.push_back( unite( *i++, *j++ ) );
+         }
+      }
+      return result;
+   }
+
+   RoaringBitmap& operator&=( RoaringBitmap const& other ) { return *this = *this & other; }
+   RoaringBitmap& operator|=( RoaringBitmap const& other ) { return *this = *this | other; }
+
+ private:
+   Container const* find( std::uint16_t key ) const
+   {
+      auto const pos = std::lower_bound( containers_.begin(), containers_.end(), key,
+                                         []( Container const& c, std::uint16_t k ){ return c.key < k; } );
+      return pos != containers_.end() && pos->key == key ? &*pos : nullptr;
+   }
+
+   static Container intersect( Container const& a, Container const& b )
+   {
+      Container result;
+      result.key = a.key;
+      if( a.isBitmap() && b.isBitmap() ) {
+         result.bits.resize( bitmapWords );
+         for( std::size_t w=0U; w<bitmapWords; ++w ) {
+            result.bits[w] = a.bits[w] & b.bits[w];
+            result.cardinality += popcount( result.bits[w] );
+         }
+         result.normalize();
+      }
+      else if( a.isBitmap() || b.isBitmap() ) {
+         Container const& bitmap = a.isBitmap() ? a : b;
+         Container const& array  = a.isBitmap() ? b : a;
+         for( std::uint16_t low : array.array ) {
+            if( bitmap.contains( low ) ) {
+               result.array.push_back( low );
+            }
+         }
+         result.cardinality = result.array.size();
+      }
+      else {
+         std::set_intersection( a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                                std::back_inserter( result.array ) );
+         result.cardinality = result.array.size();
+      }
+      return result;
+   }
+
+   static Container unite( Container const& a, Container const& b )
+   {
+      Container result;
+      result.key = a.key;
+      if( !a.isBitmap() && !b.isBitmap() && a.cardinality + b.cardinality <= maxArraySize ) {
+         std::set_union( a.array.begin(), a.array.end(), b.array.begin(), b.array.end(),
+                         std::back_inserter( result.array ) );
+         result.cardinality = result.array.size();
+         return result;
+      }
+      result.bits.assign( bitmapWords, 0U );
+      for( Container const* c : { &a, &b } ) {
+         if( c->isBitmap() ) {
+            for( std::size_t w=0U; w<bitmapWords; ++w ) {
+               result.bits[w] |= c->bits[w];
+            }
+         }
+         else {
+            for( std::uint16_t low : c->array ) {
+               result.bits[low >> 6U] |= std::uint64_t{1} << ( low & 63U );
+            }
+         }
+      }
+      for( std::uint64_t word : result.bits ) {
+         result.cardinality += popcount( word );
+      }
+      result.normalize();
+      return result;
+   }
+
+   std::vector<Container> containers_;  // Sorted by key
+};
+
+
+// Bitmap index over an Ints column: one compressed position bitmap per distinct value. Equality,
+// IN-list and range predicates, and their AND/OR combinations, are answered by bitmap operations
+// and popcounts without touching the base data again.
+class BitmapIndex
+{
+ public:
+   template< typename Range >
+   explicit BitmapIndex( Range const& column )
+   {
+      std::uint32_t position = 0U;
+      for( int value : column ) {
+         bitmaps_[value].add( position++ );
+      }
+   }
+
+   RoaringBitmap const& equal( int value ) const
+   {
+      static RoaringBitmap const none{};
+      auto const pos = bitmaps_.find( value );
+      return pos != bitmaps_.end() ? pos->second : none;
+   }
+
+   RoaringBitmap in( std::initializer_list<int> values ) const
+   {
+      RoaringBitmap result;
+      for( int value : values ) {
+         result |= equal( value );
+      }
+      return result;
+   }
+
+   // Positions of all values in the closed interval [low,high]
+   RoaringBitmap range( int low, int high ) const
+   {
+      RoaringBitmap result;
+      for( auto pos=bitmaps_.lower_bound( low ); pos!=bitmaps_.end() && pos->first<=high; ++pos ) {
+         result |= pos->second;
+      }
+      return result;
+   }
+
+   std::size_t count( int value ) const { return equal( value ).cardinality(); }
+
+ private:
+   std::map<int,RoaringBitmap> bitmaps_;
+};
+
+
+void findFirstFive( BitmapIndex const& index )
+{
+    RoaringBitmap const& fives = index.equal(5);
+    if (!fives.empty()){
+        std::cout << "Found element 5";
+    } else{
+        std::cout << "Could not find element";
+    }
+}
+
+
+void countNumberOfFives( BitmapIndex const& index )
+{
+   std::cout << "Number of elements found: " << index.count(5);
+}
+
+
+// 64-bit finalizer of splitmix64, mixes all input bits into all output bits
+std::uint64_t mixBits( std::uint64_t x ) noexcept
+{
+   x ^= x >> 30U;
+   x *= 0xBF58476D1CE4E5B9ULL;
+   x ^= x >> 27U;
+   x *= 0x94D049BB133111EBULL;
+   x ^= x >> 31U;
+   return x;
+}
+
+
+// Open-addressing hash set of ints with linear probing, used for exact distinct counting
+class IntHashSet
+{
+ public:
+   explicit IntHashSet( std::size_t expected = 16U )
+   {
+      std::size_t capacity = 16U;
+      while( capacity < 2U * expected ) capacity *= 2U;
+      slots_.resize( capacity );
+      used_.resize( capacity );
+   }
+
+   std::size_t size() const noexcept { return size_; }
+
+   // Returns true if the value was not yet contained
+   bool insert( int value )
+   {
+      if( 2U * ( size_ + 1U ) > slots_.size() ) {
+         grow();
+      }
+      std::size_t const mask = slots_.size() - 1U;
+      for( std::size_t i=mixBits( static_cast<std::uint32_t>( value ) ) & mask; ; i=(i+1U) & mask ) {
+         if( !used_[i] ) {
+            used_[i] = 1U;
+            slots_[i] = value;
+            ++size_;
+            return true;
+         }
+         if( slots_[i] == value ) {
+            return false;
+         }
+      }
+   }
+
+ private:
+   void grow()
+   {
+      IntHashSet bigger( slots_.size() );
+      for( std::size_t i=0U; i<slots_.size(); ++i ) {
+         if( used_[i] ) bigger.insert( slots_[i] );
+      }
+      *this = std::move( bigger );
+   }
+
+   Ints slots_;
+   std::vector<std::uint8_t> used_;
+   std::size_t size_{ 0U };
+};
+
+
+// Removes duplicates while keeping the first occurrence of every value in its original position
+template< typename Range >
+Ints dedupe( Range const& ints )
+{
+   IntHashSet seen( static_cast<std::size_t>( std::distance( std::begin(ints), std::end(ints) ) ) );
+   Ints result;
+   for( int value : ints ) {
+      if( seen.insert( value ) ) {
+         result.push_back( value );
+      }
+   }
+   return result;
+}
+
+
+template< typename Range >
+std::size_t countDistinct( Range const& ints )
+{
+   IntHashSet seen( static_cast<std::size_t>( std::distance( std::begin(ints), std::end(ints) ) ) );
+   for( int value : ints ) {
+      seen.insert( value );
+   }
+   return seen.size();
+}
+
+
+// HyperLogLog sketch for approximate distinct counting in a single streaming pass. With the
+// default precision of 12 the state is 4 KiB and the standard error about 1.6%. Sketches of
+// the same precision built over disjoint parts of the data can be merged.
+class HyperLogLog
+{
+ public:
+   explicit HyperLogLog( unsigned precision = 12U )
+      : precision_( std::min( std::max( precision, 4U ), 18U ) )
+      , registers_( std::size_t{1} << precision_ )
+   {}
+
+   void add( int value ) noexcept
+   {
+      std::uint64_t const hash = mixBits( static_cast<std::uint32_t>( value ) );
+      std::size_t const index = static_cast<std::size_t>( hash >> ( 64U - precision_ ) );
+      // Rank of the first set bit in the remaining bits; a sentinel bit bounds the result
+      std::uint64_t const rest = ( hash << precision_ ) | ( std::uint64_t{1} << ( precision_ - 1U ) );
+      std::uint8_t const rank = static_cast<std::uint8_t>( countLeadingZeros( rest ) + 1U );
+      registers_[index] = std::max( registers_[index], rank );
+   }
+
+   template< typename Range >
+   void add( Range const& ints ) noexcept
+   {
+      for( int value : ints ) {
+         add( value );
+      }
+   }
+
+   // Precondition: both sketches use the same precision
+   void merge( HyperLogLog const& other ) noexcept
+   {
+      for( std::size_t i=0U; i<registers_.size(); ++i ) {
+         registers_[i] = std::max( registers_[i], other.registers_[i] );
+      }
+   }
+
+   double estimate() const noexcept
+   {
+      double const m = static_cast<double>( registers_.size() );
+      double sum = 0.0;
+      std::size_t zeros = 0U;
+      for( std::uint8_t r : registers_ ) {
+         sum += std::ldexp( 1.0, -static_cast<int>( r ) );
+         zeros += ( r == 0U );
+      }
+      double const alpha = 0.7213 / ( 1.0 + 1.079 / m );
+      double const raw = alpha * m * m / sum;
+      // Linear counting is more accurate while many registers are still empty
+      if( raw <= 2.5 * m && zeros > 0U ) {
+         return m * std::log( m / static_cast<double>( zeros ) );
+      }
+      return raw;
+   }
 
+ private:
+   static unsigned countLeadingZeros( std::uint64_t x ) noexcept
+   {
+#if defined(__GNUC__)
+      return static_cast<unsigned>( __builtin_clzll( x ) );
+#else
+      unsigned n = 0U;
+      for( std::uint64_t bit=std::uint64_t{1} << 63U; ( x & bit ) == 0U; bit>>=1U ) ++n;
+      return n;
+#endif
+   }
+
+   unsigned precision_;
+   std::vector<std::uint8_t> registers_;
+};
+
+
+// Builds one sketch per chunk on the pool and merges them
+double approximateDistinct( int const* first, int const* last, ThreadPool& pool = sharedThreadPool() )
+{
+   std::size_t const n = static_cast<std::size_t>( last - first );
+   std::size_t const chunks = std::max<std::size_t>( 1U, std::min( pool.size(), n / parallelSortCutoff ) );
+
+   std::vector<HyperLogLog> sketches( chunks );
+   std::vector<std::future<void>> futures;
+   for( std::size_t c=0U; c<chunks; ++c ) {
+      HyperLogLog* const sketch = &sketches[c];
+      int const* const begin = first + n * c / chunks;
+      int const* const end   = first + n * ( c + 1U ) / chunks;
+      futures.push_back( pool.submit( [=]{ for( int const* p=begin; p!=end; ++p ) sketch->add( *p ); } ) );
+   }
+   waitAll( futures );
+
+   for( std::size_t c=1U; c<chunks; ++c ) {
+      sketches[0].merge( sketches[c] );
+   }
+   return sketches[0].estimate();
+}
+
+
+// Above this size ratio the sorted set operations binary-search the larger input (galloping)
+// instead of merging through it element by element
+constexpr std::size_t gallopingRatio = 32U;
+
+
+// Exponential search for the first element not less than 'value'; cheap when the answer is close
+int const* gallop( int const* first, int const* last, int value )
+{
+   std::size_t step = 1U;
+   int const* low = first;
+   while( static_cast<std::size_t>( last - low ) > step && low[step] < value ) {
+      low += step;
+      step *= 2U;
+   }
+   return std::lower_bound( low, std::min( low + step + 1U, last ), value );
+}
+
+
+// Intersection of two strictly increasing ranges into 'out', which must have room for
+// min(na,nb)+3 elements. Returns the number of common elements.
+std::size_t intersectMerge( int const* a, std::size_t na, int const* b, std::size_t nb, int* out )
+{
+   std::size_t i = 0U, j = 0U, k = 0U;
+#if defined(__SSE2__)
+   // Compare blocks of four against each other in all four rotations and store the matches of
+   // 'a' without branching on the data
+   while( i + 4U <= na && j + 4U <= nb ) {
+      __m128i const va = _mm_loadu_si128( reinterpret_cast<__m128i const*>( a + i ) );
+      __m128i const vb = _mm_loadu_si128( reinterpret_cast<__m128i const*>( b + j ) );
+      __m128i const eq = _mm_or_si128(
+         _mm_or_si128( _mm_cmpeq_epi32( va, vb ), _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, 0x39 ) ) ),
+         _mm_or_si128( _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, 0x4E ) ), _mm_cmpeq_epi32( va, _mm_shuffle_epi32( vb, 0x93 ) ) ) );
+      int const mask = _mm_movemask_ps( _mm_castsi128_ps( eq ) );
+      for( std::size_t lane=0U; lane<4U; ++lane ) {
+         out[k] = a[i+lane];
+         k += ( mask >> lane ) & 1;
+      }
+      int const amax = a[i+3U];
+      int const bmax = b[j+3U];
+      i += 4U * ( amax <= bmax );
+      j += 4U * ( bmax <= amax );
+   }
+#endif
+   while( i < na && j < nb ) {
+      int const x = a[i];
+      int const y = b[j];
+      out[k] = x;
+      k += ( x == y );
+      i += ( x <= y );
+      j += ( y <= x );
+   }
+   return k;
+}
+
+
+// Intersection of two sorted posting lists (strictly increasing values)
+Ints intersectSorted( Ints const& a, Ints const& b )
+{
+   Ints const& small = a.size() <= b.size() ? a : b;
+   Ints const& large = a.size() <= b.size() ? b : a;
+   Ints result( small.size() + 3U );
+   std::size_t k = 0U;
+
+   if( small.size() * gallopingRatio < large.size() ) {
+      int const* pos = large.data();
+      int const* const end = large.data() + large.size();
+      for( int value : small ) {
+         pos = gallop( pos, end, value );
+         if( pos == end ) break;
+         result[k] = value;
+         k += ( *pos == value );
+      }
+   }
+   else {
+      k = intersectMerge( a.data(), a.size(), b.data(), b.size(), result.data() );
+   }
+
+   result.resize( k );
+   return result;
+}
+
+
+// Union of two sorted posting lists (strictly increasing values)
+Ints uniteSorted( Ints const& a, Ints const& b )
+{
+   Ints const& small = a.size() <= b.size() ? a : b;
+   Ints const& large = a.size() <= b.size() ? b : a;
+   Ints result( a.size() + b.size() );
+   int* out = result.data();
+
+   if( small.size() * gallopingRatio < large.size() ) {
+      // Copy the stretches of the large input between consecutive small elements in bulk
+      int const* pos = large.data();
+      int const* const end = large.data() + large.size();
+      for( int value : small ) {
+         int const* const next = gallop( pos, end, value );
+         out = std::copy( pos, next, out );
+         *out++ = value;
+         pos = ( next != end && *next == value ) ? next + 1 : next;
+      }
+      out = std::copy( pos, end, out );
+   }
+   else {
+      std::size_t i = 0U, j = 0U;
+      while( i < a.size() && j < b.size() ) {
+         int const x = a[i];
+         int const y = b[j];
+         *out++ = std::min( x, y );
+         i += ( x <= y );
+         j += ( y <= x );
+      }
+      out = std::copy( a.begin() + i, a.end(), out );
+      out = std::copy( b.begin() + j, b.end(), out );
+   }
+
+   result.resize( static_cast<std::size_t>( out - result.data() ) );
+   return result;
+}
+
+
+// Elements of 'a' that are not in 'b', both sorted posting lists (strictly increasing values)
+Ints subtractSorted( Ints const& a, Ints const& b )
+{
+   Ints result( a.size() );
+   int* out = result.data();
+   int const* const aEnd = a.data() + a.size();
+   int const* const bEnd = b.data() + b.size();
+
+   if( a.size() * gallopingRatio < b.size() ) {
+      int const* pos = b.data();
+      for( int value : a ) {
+         pos = gallop( pos, bEnd, value );
+         *out = value;
+         out += ( pos == bEnd || *pos != value );
+      }
+   }
+   else if( b.size() * gallopingRatio < a.size() ) {
+      // Copy the stretches of 'a' between consecutive elements of 'b' in bulk
+      int const* pos = a.data();
+      for( int value : b ) {
+         int const* const next = gallop( pos, aEnd, value );
+         out = std::copy( pos, next, out );
+         pos = ( next != aEnd && *next == value ) ? next + 1 : next;
+      }
+      out = std::copy( pos, aEnd, out );
+   }
+   else {
+      std::size_t i = 0U, j = 0U;
+      while( i < a.size() && j < b.size() ) {
+         int const x = a[i];
+         int const y = b[j];
+         *out = x;
+         out += ( x < y );
+         i += ( x <= y );
+         j += ( y <= x );
+      }
+      out = std::copy( a.begin() + i, a.end(), out );
+   }
+
+   result.resize( static_cast<std::size_t>( out - result.data() ) );
+   return result;
+}
+
+
+// Sorted Ints stored as deltas, bit-packed in blocks of 128 values with a skip table holding the
+// first value, bit width and offset of every block. Searches binary-search the skip table and
+// decode at most one block; scans decode one block at a time with width-specialised decoders
+// whose fixed shifts and masks let the compiler unroll and vectorize them. A scan unpacks, sums
+// up and hands on four values at a time in registers, without a round trip through a buffer.
+class CompressedInts
+{
+ public:
+   static constexpr std::size_t blockSize = 128U;
+   static constexpr std::size_t lanes     = 4U;
+
+   CompressedInts() = default;
+
+   // Precondition: 'sorted' is in non-decreasing order
+   explicit CompressedInts( Ints const& sorted )
+      : size_( sorted.size() )
+   {
+      std::array<std::uint32_t,blockSize> deltas{};
+      for( std::size_t first=0U; first<size_; first+=blockSize )
+      {
+         std::size_t const length = std::min( blockSize, size_ - first );
+         std::uint32_t maxDelta = 0U;
+         deltas.fill( 0U );
+         for( std::size_t i=1U; i<length; ++i ) {
+            deltas[i] = static_cast<std::uint32_t>( sorted[first+i] ) - static_cast<std::uint32_t>( sorted[first+i-1U] );
+            maxDelta = std::max( maxDelta, deltas[i] );
+         }
+
+         unsigned width = 0U;
+         while( width < 32U && ( maxDelta >> width ) != 0U ) ++width;
+
+         skips_.push_back( Skip{ sorted[first], static_cast<std::uint32_t>( words_.size() ), width } );
+         std::size_t const offset = words_.size();
+         words_.resize( offset + blockSize * width / 32U );
+         // Vertical layout: delta i goes to lane i%4 at slot i/4, and the four lanes are
+         // interleaved word by word so that one SIMD register unpacks four deltas at once
+         for( std::size_t i=0U; i<blockSize && width>0U; ++i ) {
+            std::size_t const bit  = ( i / lanes ) * width;
+            std::size_t const word = offset + ( bit / 32U ) * lanes + i % lanes;
+            std::uint64_t const shifted = std::uint64_t{deltas[i]} << ( bit & 31U );
+            words_[word] |= static_cast<std::uint32_t>( shifted );
+            if( ( bit & 31U ) + width > 32U ) {
+               words_[word + lanes] |= static_cast<std::uint32_t>( shifted >> 32U );
+            }
+         }
+      }
+   }
+
+   std::size_t size() const noexcept { return size_; }
+   bool empty() const noexcept { return size_ == 0U; }
+   std::size_t blocks() const noexcept { return skips_.size(); }
+
+   std::size_t memoryBytes() const noexcept
+   {
+      return words_.size() * sizeof(std::uint32_t) + skips_.size() * sizeof(Skip);
+   }
+
+   // Decodes block 'k' into 'out' (room for blockSize values) and returns the number of valid values
+   std::size_t decodeBlock( std::size_t k, int* out ) const
+   {
+      Skip const& skip = skips_[k];
+      auto store = [out]( int value ) mutable { *out++ = value; };
+      decoder<decltype(store)>( skip.width )( words_.data() + skip.offset, skip.first, store );
+      return std::min( blockSize, size_ - k * blockSize );
+   }
+
+   std::size_t lower_bound( int value ) const
+   {
+      return bound( value, []( int a, int b ){ return a < b; } );
+   }
+
+   std::size_t upper_bound( int value ) const
+   {
+      return bound( value, []( int a, int b ){ return a <= b; } );
+   }
+
+   std::size_t count( int value ) const { return upper_bound( value ) - lower_bound( value ); }
+
+   // Position of the first occurrence of 'value', or size() if there is none
+   std::size_t find( int value ) const
+   {
+      std::size_t const pos = lower_bound( value );
+      return pos < size_ && at( pos ) == value ? pos : size_;
+   }
+
+   int at( std::size_t pos ) const
+   {
+      std::array<int,blockSize> block;
+      decodeBlock( pos / blockSize, block.data() );
+      return block[pos % blockSize];
+   }
+
+   template< typename Function >
+   void forEach( Function f ) const
+   {
+      std::size_t const full = size_ / blockSize;
+      for( std::size_t k=0U; k<full; ++k ) {
+         Skip const& skip = skips_[k];
+         decoder<Function>( skip.width )( words_.data() + skip.offset, skip.first, f );
+      }
+
+      // The padding of the last, partial block must not reach 'f'
+      if( full < skips_.size() ) {
+         std::array<int,blockSize> block;
+         std::size_t const length = decodeBlock( full, block.data() );
+         std::for_each( block.begin(), block.begin() + length, std::ref( f ) );
+      }
+   }
+
+   Ints decompress() const
+   {
+      Ints result( skips_.size() * blockSize );
+      for( std::size_t k=0U; k<skips_.size(); ++k ) {
+         decodeBlock( k, result.data() + k * blockSize );
+      }
+      result.resize( size_ );
+      return result;
+   }
+
+ private:
+   struct Skip
+   {
+      int first;
+      std::uint32_t offset;  // Index of the first packed word of the block
+      unsigned width;        // Bits per delta
+   };
+
+   template< typename Function >
+   using Decoder = void (*)( std::uint32_t const*, int, Function& );
+
+   // Calls 'f' on the blockSize values of the block packed at 'Width' bits per delta at 'in'
+   template< unsigned Width, typename Function >
+   static void decode( std::uint32_t const* in, int first, Function& f )
+   {
+      // After unrolling, all word offsets and shift amounts are compile-time constants and the
+      // lane loop maps onto one SIMD operation per step
+      constexpr std::uint32_t mask = Width == 32U ? ~std::uint32_t{0} : ( std::uint32_t{1} << Width ) - 1U;
+#if defined(__SSE2__)
+      __m128i carry = _mm_set1_epi32( first );
+#else
+      std::uint32_t value = static_cast<std::uint32_t>( first );
+#endif
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC unroll 32
+#endif
+      for( std::size_t slot=0U; slot<blockSize/lanes; ++slot ) {
+         std::size_t const bit   = slot * Width;
+         std::size_t const word  = ( bit / 32U ) * lanes;
+         std::size_t const shift = bit & 31U;
+#if defined(__SSE2__)
+         __m128i x = _mm_setzero_si128();
+         if constexpr( Width > 0U ) {
+            x = _mm_srli_epi32( _mm_loadu_si128( reinterpret_cast<__m128i const*>( in + word ) ), static_cast<int>( shift ) );
+            if( shift + Width > 32U ) {
+               __m128i const next = _mm_loadu_si128( reinterpret_cast<__m128i const*>( in + word + lanes ) );
+               x = _mm_or_si128( x, _mm_slli_epi32( next, static_cast<int>( 32U - shift ) ) );
+            }
+            x = _mm_and_si128( x, _mm_set1_epi32( static_cast<int>( mask ) ) );
+         }
+
+         // Prefix sum over the four lanes: two shifted adds within the register plus the carry
+         x = _mm_add_epi32( x, _mm_slli_si128( x, 4 ) );
+         x = _mm_add_epi32( x, _mm_slli_si128( x, 8 ) );
+         x = _mm_add_epi32( x, carry );
+         carry = _mm_shuffle_epi32( x, 0xFF );
+
+         alignas(16) std::array<int,lanes> values;
+         _mm_store_si128( reinterpret_cast<__m128i*>( values.data() ), x );
+         for( int v : values ) {
+            f( v );
+         }
+#else
+         for( std::size_t lane=0U; lane<lanes; ++lane ) {
+            std::uint32_t delta = 0U;
+            if constexpr( Width > 0U ) {
+               delta = in[word + lane] >> shift;
+               if( shift + Width > 32U ) {
+                  delta |= in[word + lanes + lane] << ( 32U - shift );
+               }
+            }
+            value += delta & mask;
+            f( static_cast<int>( value ) );
+         }
+#endif
+      }
+   }
+
+   template< typename Function, std::size_t... Widths >
+   static constexpr std::array<Decoder<Function>,sizeof...(Widths)> makeDecoders( std::index_sequence<Widths...> )
+   {
+      return {{ &decode<Widths,Function>... }};
+   }
+
+   template< typename Function >
+   static Decoder<Function> decoder( unsigned width ) noexcept
+   {
+      static constexpr std::array<Decoder<Function>,33U> decoders = makeDecoders<Function>( std::make_index_sequence<33U>{} );
+      return decoders[width];
+   }
+
+   // Number of elements e for which before(e,value) holds, i.e. the matching lower/upper bound
+   template< typename Before >
+   std::size_t bound( int value, Before before ) const
+   {
+      auto const block = std::partition_point( skips_.begin(), skips_.end(),
+                                               [&]( Skip const& s ){ return before( s.first, value ); } );
+      if( block == skips_.begin() ) return 0U;
+
+      std::size_t const k = static_cast<std::size_t>( block - skips_.begin() ) - 1U;
+      std::array<int,blockSize> values;
+      std::size_t const length = decodeBlock( k, values.data() );
+      auto const pos = std::partition_point( values.begin(), values.begin() + length,
+                                             [&]( int v ){ return before( v, value ); } );
+      return k * blockSize + static_cast<std::size_t>( pos - values.begin() );
+   }
+
+   std::size_t size_{ 0U };
+   std::vector<Skip> skips_;
+   std::vector<std::uint32_t> words_;
+};
+
+
+// Binary file of little-endian T values mapped into memory. Opening is near-instant regardless of
+// the file size since pages are only read on first access. The mapping is private: read-only
+// algorithms work on the file pages without any copy, and writes copy only the touched pages
+// while the file itself stays unmodified.
+template< typename T >
+class MappedArray
+{
+   static_assert( std::is_arithmetic<T>::value, "MappedArray requires an arithmetic element type" );
+
+ public:
+   explicit MappedArray( std::string const& path )
+   {
+      std::uint16_t const probe = 1U;
+      unsigned char firstByte = 0U;
+      std::memcpy( &firstByte, &probe, 1U );
+      if( firstByte != 1U ) {
+         throw std::runtime_error( "MappedArray requires a little-endian host" );
+      }
+
+      int const fd = ::open( path.c_str(), O_RDONLY );
+      if( fd < 0 ) {
+         throw std::system_error( errno, std::generic_category(), "Cannot open '" + path + "'" );
+      }
+
+      struct stat info{};
+      if( ::fstat( fd, &info ) != 0 ) {
+         int const error = errno;
+         ::close( fd );
+         throw std::system_error( error, std::generic_category(), "Cannot stat '" + path + "'" );
+      }
+
+      std::size_t const bytes = static_cast<std::size_t>( info.st_size );
+      if( bytes % sizeof(T) != 0U ) {
+         ::close( fd );
+         throw std::runtime_error( "Size of '" + path + "' is not a multiple of the element size" );
+      }
+
+      if( bytes > 0U ) {
+         void* const address = ::mmap( nullptr, bytes, PROT_READ | PROT_WRITE, MAP_PRIVATE, fd, 0 );
+         int const error = errno;
+         ::close( fd );
+         if( address == MAP_FAILED ) {
+            throw std::system_error( error, std::generic_category(), "Cannot map '" + path + "'" );
+         }
+         data_ = static_cast<T*>( address );
+         size_ = bytes / sizeof(T);
+      }
+      else {
+         ::close( fd );
+      }
+   }
+
+   MappedArray( MappedArray&& other ) noexcept
+      : data_( std::exchange( other.data_, nullptr ) )
+      , size_( std::exchange( other.size_, 0U ) )
+   {}
+
+   MappedArray& operator=( MappedArray&& other ) noexcept
+   {
+      std::swap( data_, other.data_ );
+      std::swap( size_, other.size_ );
+      return *this;
+   }
+
+   MappedArray( MappedArray const& ) = delete;
+   MappedArray& operator=( MappedArray const& ) = delete;
+
+   ~MappedArray()
+   {
+      if( data_ != nullptr ) {
+         ::munmap( data_, size_ * sizeof(T) );
+      }
+   }
+
+   std::size_t size() const noexcept { return size_; }
+   bool empty() const noexcept { return size_ == 0U; }
+
+   T*       data()        noexcept { return data_; }
+   T const* data()  const noexcept { return data_; }
+   T*       begin()       noexcept { return data_; }
+   T const* begin() const noexcept { return data_; }
+   T*       end()         noexcept { return data_ + size_; }
+   T const* end()   const noexcept { return data_ + size_; }
+
+   T&       operator[]( std::size_t i )       noexcept { return data_[i]; }
+   T const& operator[]( std::size_t i ) const noexcept { return data_[i]; }
+
+ private:
+   T* data_{ nullptr };
+   std::size_t size_{ 0U };
+};
+
+
+// Temporary file in 'directory' that is unlinked right away and disappears once it is closed
+std::FILE* openTempFile( std::string const& directory )
+{
+   std::string path = directory + "/STLintro-run-XXXXXX";
+   int const fd = ::mkstemp( &path[0] );
+   if( fd < 0 ) {
+      throw std::system_error( errno, std::generic_category(), "Cannot create temporary file in '" + directory + "'" );
+   }
+   ::unlink( path.c_str() );
+   std::FILE* const file = ::fdopen( fd, "w+b" );
+   if( file == nullptr ) {
+      int const error = errno;
+      ::close( fd );
+      throw std::system_error( error, std::generic_category(), "Cannot open temporary file" );
+   }
+   return file;
+}
+
+
+struct FileCloser
+{
+   void operator()( std::FILE* file ) const noexcept { std::fclose( file ); }
+};
+
+using FilePtr = std::unique_ptr<std::FILE,FileCloser>;
+
+
+template< typename T >
+std::size_t readBlock( std::FILE* file, T* data, std::size_t count )
+{
+   std::size_t const read = std::fread( data, sizeof(T), count, file );
+   if( read < count && std::ferror( file ) ) {
+      throw std::runtime_error( "Read error during external sort" );
+   }
+   return read;
+}
+
+
+template< typename T >
+void writeBlock( std::FILE* file, T const* data, std::size_t count )
+{
+   if( std::fwrite( data, sizeof(T), count, file ) != count ) {
+      throw std::runtime_error( "Write error during external sort" );
+   }
+}
+
+
+// Sequential reader of a sorted run that prefetches the next block while the current one is consumed.
+// The two blocks live in caller-owned memory of 2*blockSize elements at 'storage'. The reads are
+// queued on 'io', so any number of readers share the threads of that pool.
+template< typename T >
+class RunReader
+{
+ public:
+   RunReader( std::FILE* file, T* storage, std::size_t blockSize, ThreadPool& io )
+      : file_( file )
+      , current_( storage )
+      , next_( storage + blockSize )
+      , blockSize_( blockSize )
+      , io_( io )
+   {
+      prefetch();
+      refill();
+   }
+
+   RunReader( RunReader const& ) = delete;
+   RunReader& operator=( RunReader const& ) = delete;
+
+   ~RunReader()
+   {
+      if( pending_.valid() ) {
+         pending_.wait();
+      }
+   }
+
+   bool empty() const noexcept { return pos_ == size_; }
+   T const& head() const noexcept { return current_[pos_]; }
+
+   void pop()
+   {
+      if( ++pos_ == size_ ) {
+         refill();
+      }
+   }
+
+ private:
+   void prefetch()
+   {
+      pending_ = io_.submit( [this]{ read_ = readBlock( file_, next_, blockSize_ ); } );
+   }
+
+   void refill()
+   {
+      pending_.get();
+      size_ = read_;
+      pos_ = 0U;
+      std::swap( current_, next_ );
+      if( size_ > 0U ) {
+         prefetch();
+      }
+   }
+
+   std::FILE* file_;
+   T* current_;
+   T* next_;
+   std::size_t blockSize_;
+   ThreadPool& io_;
+   std::future<void> pending_;
+   std::size_t read_{ 0U };   // Written by the pending read
+   std::size_t pos_{ 0U };
+   std::size_t size_{ 0U };
+};
+
+
+// Buffered writer that hands full blocks to a background write on 'io' while the next block is filled.
+// The two blocks live in caller-owned memory of 2*blockSize elements at 'storage'.
+template< typename T >
+class RunWriter
+{
+ public:
+   RunWriter( std::FILE* file, T* storage, std::size_t blockSize, ThreadPool& io )
+      : file_( file )
+      , current_( storage )
+      , next_( storage + blockSize )
+      , blockSize_( blockSize )
+      , io_( io )
+   {}
+
+   RunWriter( RunWriter const& ) = delete;
+   RunWriter& operator=( RunWriter const& ) = delete;
+
+   ~RunWriter()
+   {
+      if( pending_.valid() ) {
+         pending_.wait();
+      }
+   }
+
+   void push( T const& value )
+   {
+      current_[size_++] = value;
+      if( size_ == blockSize_ ) {
+         submit();
+      }
+   }
+
+   void finish()
+   {
+      submit();
+      if( pending_.valid() ) {
+         pending_.get();
+      }
+   }
+
+ private:
+   void submit()
+   {
+      if( pending_.valid() ) {
+         pending_.get();
+      }
+      std::swap( current_, next_ );
+      pending_ = io_.submit( [this,size=size_]{ writeBlock( file_, next_, size ); } );
+      size_ = 0U;
+   }
+
+   std::FILE* file_;
+   T* current_;
+   T* next_;
+   std::size_t blockSize_;
+   ThreadPool& io_;
+   std::size_t size_{ 0U };
+   std::future<void> pending_;
+};
+
+
+// Tournament tree of losers for k-way merging: after each pop only the path from the winner's leaf
+// to the root is replayed, costing about log2(k) comparisons per output element.
+template< typename T >
+class LoserTree
+{
+ public:
+   explicit LoserTree( std::deque<RunReader<T>>& runs )
+      : runs_( runs )
+      , tree_( std::max<std::size_t>( runs.size(), 1U ) )
+   {
+      tree_[0] = runs_.size() > 1U ? init( 1U ) : 0U;
+   }
+
+   bool empty() const noexcept { return runs_.empty() || runs_[tree_[0]].empty(); }
+   T const& top() const noexcept { return runs_[tree_[0]].head(); }
+
+   void pop()
+   {
+      std::size_t winner = tree_[0];
+      runs_[winner].pop();
+      for( std::size_t node=( winner + runs_.size() ) / 2U; node>0U; node/=2U ) {
+         if( beats( tree_[node], winner ) ) {
+            std::swap( tree_[node], winner );
+         }
+      }
+      tree_[0] = winner;
+   }
+
+ private:
+   // Exhausted runs lose against every other run
+   bool beats( std::size_t a, std::size_t b ) const noexcept
+   {
+      if( runs_[a].empty() ) return false;
+      if( runs_[b].empty() ) return true;
+      return runs_[a].head() < runs_[b].head();
+   }
+
+   std::size_t init( std::size_t node )
+   {
+      if( node >= runs_.size() ) {
+         return node - runs_.size();
+      }
+      std::size_t const left  = init( 2U * node );
+      std::size_t const right = init( 2U * node + 1U );
+      bool const leftWins = !beats( right, left );
+      tree_[node] = leftWins ? right : left;
+      return leftWins ? left : right;
+   }
+
+   std::deque<RunReader<T>>& runs_;
+   std::vector<std::size_t> tree_;
+};
+
+
+// Merges the given sorted runs into 'output', splitting the n elements of 'memory' over all I/O buffers
+template< typename T >
+void mergeRuns( std::vector<FilePtr> const& runs, std::FILE* output, T* memory, std::size_t n )
+{
+   // Every run and the output use two blocks each (one in flight, one being consumed)
+   std::size_t const blockSize = std::max<std::size_t>( 1U, n / ( 2U * ( runs.size() + 1U ) ) );
+
+   // A single I/O thread serves all runs and the output in the order the merge asks for blocks, so
+   // a large fan-in neither starts a thread per block nor lets hundreds of reads compete for the disk
+   ThreadPool io( 1U );
+
+   std::deque<RunReader<T>> readers;
+   for( auto const& run : runs ) {
+      std::rewind( run.get() );
+      readers.emplace_back( run.get(), memory, blockSize, io );
+      memory += 2U * blockSize;
+   }
+
+   RunWriter<T> writer( output, memory, blockSize, io );
+   for( LoserTree<T> tree( readers ); !tree.empty(); tree.pop() ) {
+      writer.push( tree.top() );
+   }
+   writer.finish();
+}
+
+
+// Blocks smaller than this make the merge seek-bound, so the fan-in is limited to keep them larger
+constexpr std::size_t minMergeBlockBytes = std::size_t{1} << 20;
+
+
+// Directory for the runs of externalSort() unless one is given: $TMPDIR, or else the directory of
+// the output file, which has to hold the sorted data anyway. /tmp is often a RAM disk or small.
+std::string defaultTempDirectory( std::string const& output )
+{
+   char const* const tmpdir = std::getenv( "TMPDIR" );
+   if( tmpdir != nullptr && *tmpdir != '\0' ) {
+      return tmpdir;
+   }
+   std::size_t const slash = output.find_last_of( '/' );
+   return slash == std::string::npos ? std::string( "." ) : output.substr( 0U, slash );
+}
+
+
+// Sorts a binary file of T values that may be much larger than main memory. Sorted runs of a
+// quarter of the memory budget are produced while the next run is read and the previous one is
+// written; they are then combined by loser-tree k-way merges with large prefetched blocks.
+template< typename T >
+void externalSort( std::string const& input, std::string const& output, std::size_t memoryBudget,
+                   std::string tempDirectory = {} )
+{
+   if( tempDirectory.empty() ) {
+      tempDirectory = defaultTempDirectory( output );
+   }
+
+   FilePtr in( std::fopen( input.c_str(), "rb" ) );
+   if( !in ) {
+      throw std::system_error( errno, std::generic_category(), "Cannot open '" + input + "'" );
+   }
+
+   // All buffers of both phases are carved out of this single allocation, so the process keeps to
+   // the budget and no freed buffer of the run phase lingers in the heap during the merges
+   std::vector<T> memory( std::max<std::size_t>( 4U, memoryBudget / sizeof(T) ) );
+
+   // Run generation: one buffer is read, one is sorted (with the scratch buffer) and one is written
+   // at the same time. The sort takes its scratch memory only from 'scratch'.
+   std::size_t const runSize = memory.size() / 4U;
+   std::array<T*,3U> const buffers{ memory.data(), memory.data() + runSize, memory.data() + 2U*runSize };
+   T* const scratch = memory.data() + 3U*runSize;
+
+   std::vector<FilePtr> runs;
+   std::size_t filled = readBlock( in.get(), buffers[0], runSize );
+   std::future<void> writing;
+   for( std::size_t step=0U; filled > 0U; ++step )
+   {
+      T* const sortBuffer = buffers[step % 3U];
+      T* const readBuffer = buffers[( step + 1U ) % 3U];
+      auto reading = std::async( std::launch::async, [&]{ return readBlock( in.get(), readBuffer, runSize ); } );
+
+      parallelSort( sortBuffer, sortBuffer + filled, scratch );
+
+      if( writing.valid() ) {
+         writing.get();
+      }
+      runs.emplace_back( openTempFile( tempDirectory ) );
+      writing = std::async( std::launch::async, [run=runs.back().get(),sortBuffer,filled]{
+         writeBlock( run, sortBuffer, filled );
+      } );
+      filled = reading.get();
+   }
+   if( writing.valid() ) {
+      writing.get();
+   }
+
+   // Merge passes until the remaining runs fit into one merge with large enough blocks
+   std::size_t const maxFanIn = std::max<std::size_t>( 3U, memoryBudget / ( 2U * minMergeBlockBytes ) ) - 1U;
+   while( runs.size() > maxFanIn )
+   {
+      std::vector<FilePtr> merged;
+      for( std::size_t first=0U; first<runs.size(); first+=maxFanIn )
+      {
+         std::size_t const last = std::min( first + maxFanIn, runs.size() );
+         std::vector<FilePtr> group;
+         for( std::size_t r=first; r<last; ++r ) {
+            group.push_back( std::move( runs[r] ) );
+         }
+         merged.emplace_back( openTempFile( tempDirectory ) );
+         mergeRuns( group, merged.back().get(), memory.data(), memory.size() );
+      }
+      runs.swap( merged );
+   }
+
+   FilePtr out( std::fopen( output.c_str(), "wb" ) );
+   if( !out ) {
+      throw std::system_error( errno, std::generic_category(), "Cannot open '" + output + "'" );
+   }
+   mergeRuns( runs, out.get(), memory.data(), memory.size() );
+   if( std::fflush( out.get() ) != 0 ) {
+      throw std::runtime_error( "Cannot write '" + output + "'" );
+   }
+}
+
+
+template< typename Sort >
+double timeSort( Ints const& input, Sort sort )
+{
+    Ints ints( input );
+    auto const start = std::chrono::steady_clock::now();
+    sort(ints);
+    auto const stop = std::chrono::steady_clock::now();
+    if( !std::is_sorted(std::begin(ints), std::end(ints)) ) {
+        std::cerr << "Sort produced an unsorted result\n";
+    }
+    return std::chrono::duration<double,std::milli>( stop - start ).count();
+}
+
+
+void benchmarkSortInts()
+{
+    std::mt19937 gen( 42 );
+    std::uniform_int_distribution<int> dist( INT_MIN, INT_MAX );
+
+    for( std::size_t size : { std::size_t{1000}, std::size_t{100000}, std::size_t{10000000} } )
+    {
+        Ints input( size );
+        std::generate(std::begin(input), std::end(input), [&](){ return dist(gen); });
+
+        double const stdTime   = timeSort( input, [](Ints& v){ std::sort(std::begin(v), std::end(v)); } );
+        double const radixTime = timeSort( input, [](Ints& v){ sequentialSort(v.data(), v.data() + v.size()); } );
+        double const parTime   = timeSort( input, [](Ints& v){ parallelSort(v); } );
+
+        std::cout << " n = " << size << ": std::sort " << stdTime << " ms, radix sort " << radixTime
+                  << " ms, parallel sort (" << sharedThreadPool().size() << " threads) " << parTime << " ms\n";
+    }
+}
+
+
+void benchmarkRangeCounts()
+{
+    std::mt19937 gen( 42 );
+    std::uniform_int_distribution<int> dist( 0, 1 << 24 );
+
+    Ints sorted( 1U << 24 );
+    std::generate(std::begin(sorted), std::end(sorted), [&](){ return dist(gen); });
+    parallelSort(sorted);
+    EytzingerIndex const index( sorted );
+
+    Ints queries( 1000000 );
+    std::generate(std::begin(queries), std::end(queries), [&](){ return dist(gen); });
+
+    std::size_t flatTotal = 0U;
+    auto const flatStart = std::chrono::steady_clock::now();
+    for( int q : queries ) {
+        auto const range = std::equal_range(std::begin(sorted), std::end(sorted), q);
+        flatTotal += static_cast<std::size_t>( range.second - range.first );
+    }
+    auto const flatStop = std::chrono::steady_clock::now();
+
+    std::size_t indexTotal = 0U;
+    for( int q : queries ) {
+        indexTotal += index.count(q);
+    }
+    auto const indexStop = std::chrono::steady_clock::now();
+
+    if( flatTotal != indexTotal ) {
+        std::cerr << "Eytzinger index disagrees with std::equal_range\n";
+    }
+    std::cout << " " << queries.size() << " count queries on " << sorted.size() << " keys: std::equal_range "
+              << std::chrono::duration<double,std::milli>( flatStop - flatStart ).count() << " ms, EytzingerIndex "
+              << std::chrono::duration<double,std::milli>( indexStop - flatStop ).count() << " ms\n";
+}
+
+
+void benchmarkSetOperations()
+{
+    std::mt19937 gen( 42 );
+    auto postingList = [&]( std::size_t size, int universe ) {
+        std::uniform_int_distribution<int> dist( 0, universe );
+        Ints list( size );
+        std::generate(std::begin(list), std::end(list), [&](){ return dist(gen); });
+        parallelSort(list);
+        list.erase( std::unique(std::begin(list), std::end(list)), std::end(list) );
+        return list;
+    };
+
+    for( std::size_t smallSize : { std::size_t{1000000}, std::size_t{10000} } )
+    {
+        Ints const a = postingList( smallSize, 1 << 26 );
+        Ints const b = postingList( 1000000, 1 << 26 );
+
+        auto const start = std::chrono::steady_clock::now();
+        Ints expected;
+        std::set_intersection(std::begin(a), std::end(a), std::begin(b), std::end(b), std::back_inserter(expected));
+        auto const middle = std::chrono::steady_clock::now();
+        Ints const actual = intersectSorted( a, b );
+        auto const stop = std::chrono::steady_clock::now();
+
+        if( actual != expected ) {
+            std::cerr << "intersectSorted disagrees with std::set_intersection\n";
+        }
+        std::cout << " intersect " << a.size() << " x " << b.size() << ": std::set_intersection "
+                  << std::chrono::duration<double,std::milli>( middle - start ).count() << " ms, intersectSorted "
+                  << std::chrono::duration<double,std::milli>( stop - middle ).count() << " ms\n";
+    }
+}
+
+
+void benchmarkCompressedInts()
+{
+    std::mt19937 gen( 42 );
+    std::geometric_distribution<int> gap( 0.1 );
+
+    Ints sorted( 1U << 24 );
+    int value = 0;
+    std::generate(std::begin(sorted), std::end(sorted), [&](){ return value += gap(gen); });
+    CompressedInts const compressed( sorted );
+
+    auto const start = std::chrono::steady_clock::now();
+    long long rawSum = 0;
+    for( int v : sorted ) rawSum += v;
+    auto const middle = std::chrono::steady_clock::now();
+    long long compressedSum = 0;
+    compressed.forEach( [&compressedSum]( int v ){ compressedSum += v; } );
+    auto const stop = std::chrono::steady_clock::now();
+
+    if( rawSum != compressedSum ) {
+        std::cerr << "CompressedInts scan disagrees with the raw data\n";
+    }
+    std::cout << " scan of " << sorted.size() << " sorted ints: raw " << sorted.size() * sizeof(int) / 1024U
+              << " KiB in " << std::chrono::duration<double,std::milli>( middle - start ).count()
+              << " ms, compressed " << compressed.memoryBytes() / 1024U << " KiB in "
+              << std::chrono::duration<double,std::milli>( stop - middle ).count() << " ms\n";
+}
+
+
+
+template< typename Range >
+void solveTasks( Range& ints )
+{
    printToScreen( ints );
    std::cout << "\n";
    reverseOrder( ints );
@@ -104,3 +2253,70 @@ int main()
    findAllTwos( ints );
 }
 
+
+
+int main( int argc, char* argv[] )
+{
+   if( argc > 1 && std::string( argv[1] ) == "--bench" ) {
+      benchmarkSortInts();
+      benchmarkRangeCounts();
+      benchmarkSetOperations();
+      benchmarkCompressedInts();
+      return EXIT_SUCCESS;
+   }
+
+   // Sort a binary int32 file that may exceed main memory:
+   // STLintro --external-sort <in> <out> <budget MiB> [temp dir]
+   if( argc > 4 && std::string( argv[1] ) == "--external-sort" ) {
+      try {
+         externalSort<std::int32_t>( argv[2], argv[3], std::stoull( argv[4] ) << 20, argc > 5 ? argv[5] : "" );
+      }
+      catch( std::exception const& ex ) {
+         std::cerr << ex.what() << '\n';
+         return EXIT_FAILURE;
+      }
+      return EXIT_SUCCESS;
+   }
+
+   // Optionally run the tasks on a binary dump: STLintro <file> [int32|int64|double]
+   if( argc > 1 ) {
+      std::string const type = argc > 2 ? argv[2] : "int32";
+      try {
+         if( type == "int32" ) {
+            MappedArray<std::int32_t> ints( argv[1] );
+            solveTasks( ints );
+         }
+         else if( type == "int64" ) {
+            MappedArray<std::int64_t> ints( argv[1] );
+            solveTasks( ints );
+         }
+         else if( type == "double" ) {
+            MappedArray<double> ints( argv[1] );
+            solveTasks( ints );
+         }
+         else {
+            std::cerr << "Unknown element type '" << type << "'\n";
+            return EXIT_FAILURE;
+         }
+      }
+      catch( std::exception const& ex ) {
+         std::cerr << ex.what() << '\n';
+         return EXIT_FAILURE;
+      }
+      return EXIT_SUCCESS;
+   }
+
+   TrackedInts ints{ 3, 6, 27, 5, 1, 8, 5, 4 };
+   BitmapIndex const bitmap( ints );
+   solveTasks( ints );
+    std::cout << "\n";
+
+   // Find and count the 5s once more with the bitmap index of the original vector
+   findFirstFive( bitmap );
+    std::cout << "\n";
+   countNumberOfFives( bitmap );
+    std::cout << "\n";
+
+   // Count the 2s once more with the search index over the sorted vector
+   findAllTwos( EytzingerIndex( ints.values() ) );
+}
@@ -18,11 +18,40 @@
 **************************************************************************************************/
 
 #include <algorithm>
+#include <array>
+#include <bitset>
+#include <cerrno>
+#include <charconv>
 #include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <limits>
 #include <numeric>
+#include <stdexcept>
+#include <thread>
+#include <tuple>
+#include <type_traits>
+#include <utility>
+#include <variant>
 #include <vector>
 
+#include <unistd.h>
+
+#include "BufferedWriter.h"
+
+#if defined(__SSE2__)
+#  include <emmintrin.h>
+#endif
+#if defined(__SSSE3__)
+#  include <tmmintrin.h>
+#endif
+
 
 using Ints    = std::vector<int>;
 using Doubles = std::vector<double>;
@@ -31,59 +60,1499 @@ using Doubles = std::vector<double>;
 template< typename T >
 void printVector( std::vector<T> const& numbers )
 {
-    std::cout << "(";
-    std::for_each( std::begin(numbers), std::end(numbers), []( T value ){ std::cout << " " << value; } );
-    std::cout << " )";
+    BufferedWriter out;
+    out << "(";
+    std::for_each( std::begin(numbers), std::end(numbers), [&out]( T value ){ out << " " << value; } );
+    out << " )";
 }
 
 
-int computeProduct( Ints const& ints )
+std::size_t hardwareThreads()
 {
-    int result = 0;
-    result = std::accumulate(std::begin(ints), std::end(ints), 1, std::multiplies<>());
-    return result;
+   return std::max( 1U, std::thread::hardware_concurrency() );
+}
+
+
+// Runs 'body(first,last)' over index chunks of [0,n) on up to 'threads' threads
+template< typename Body >
+void parallelFor( std::size_t n, std::size_t minChunk, Body body, std::size_t threads = hardwareThreads() )
+{
+   std::size_t const chunks = std::max<std::size_t>( 1U, std::min( threads, n / minChunk ) );
+   std::vector<std::future<void>> futures;
+   for( std::size_t c=1U; c<chunks; ++c ) {
+      futures.push_back( std::async( std::launch::async, body, n * c / chunks, n * ( c + 1U ) / chunks ) );
+   }
+   body( std::size_t{0}, n / chunks );
+   for( auto& f : futures ) {
+      f.get();
+   }
+}
+
+
+// Number of elements that parallelReduce() always reduces as one unit
+constexpr std::size_t reductionBlock = std::size_t{1} << 14;
+
+
+// Combines block results one at a time into the same pairwise tree as parallelReduce(). Like a
+// binary counter it holds one finished subtree per set bit of the block count, i.e. at most 64.
+template< typename Result, typename Combine >
+class PairwiseTree
+{
+ public:
+   explicit PairwiseTree( Combine combine = Combine() ) : combine_( combine ) {}
+
+   void push( Result const& result )
+   {
+      subtrees_[size_++] = result;
+      for( std::uint64_t count=blocks_; count & 1U; count >>= 1U ) {
+         subtrees_[size_-2U] = combine_( subtrees_[size_-2U], subtrees_[size_-1U] );
+         --size_;
+      }
+      ++blocks_;
+   }
+
+   bool empty() const noexcept { return size_ == 0U; }
+
+   // The subtrees are joined from the right, as the last stages of the tree in parallelReduce() do
+   Result result() const
+   {
+      Result result = subtrees_[size_-1U];
+      for( std::size_t i=size_-1U; i-->0U; ) {
+         result = combine_( subtrees_[i], result );
+      }
+      return result;
+   }
+
+ private:
+   Combine combine_;
+   std::array<Result,64> subtrees_{};
+   std::size_t size_{ 0U };
+   std::uint64_t blocks_{ 0U };
+};
+
+
+// Runs 'reduce(first,last)' over the blocks of 'reductionBlock' elements of [0,n) on up to 'threads'
+// threads and combines the block results pairwise in a balanced tree. Neither the blocks nor the
+// shape of the tree depend on the number of threads, so floating-point reductions give bitwise
+// identical results for any thread count and schedule. Small inputs run on the calling thread,
+// and a single thread builds the tree in a PairwiseTree without allocating.
+template< typename Reduce, typename Combine >
+auto parallelReduce( std::size_t n, std::size_t minChunk, Reduce reduce, Combine combine,
+                     std::size_t threads = hardwareThreads() )
+{
+   std::size_t const blocks = std::max<std::size_t>( 1U, ( n + reductionBlock - 1U ) / reductionBlock );
+   if( blocks == 1U ) {
+      return reduce( std::size_t{0}, n );
+   }
+
+   using Result = decltype( reduce( std::size_t{0}, n ) );
+   std::size_t const minBlocks = std::max<std::size_t>( 1U, minChunk / reductionBlock );
+   if( std::min( threads, blocks / minBlocks ) <= 1U ) {
+      // A single thread folds the blocks in order into the tree, without storing all partial results
+      PairwiseTree<Result,Combine> tree( combine );
+      for( std::size_t b=0U; b<blocks; ++b ) {
+         tree.push( reduce( b * reductionBlock, std::min( n, ( b + 1U ) * reductionBlock ) ) );
+      }
+      return tree.result();
+   }
+
+   std::vector<Result> partials( blocks );
+   parallelFor( blocks, minBlocks, [&]( std::size_t first, std::size_t last ) {
+      for( std::size_t b=first; b<last; ++b ) {
+         partials[b] = reduce( b * reductionBlock, std::min( n, ( b + 1U ) * reductionBlock ) );
+      }
+   }, threads );
+
+   for( std::size_t stride=1U; stride<partials.size(); stride*=2U ) {
+      for( std::size_t i=0U; i+stride<partials.size(); i+=2U*stride ) {
+         partials[i] = combine( partials[i], partials[i+stride] );
+      }
+   }
+   return partials.front();
+}
+
+
+template< typename Value >
+struct ProductResult
+{
+   Value value;
+   bool overflow;  // The exact product does not fit into 'Value'
+};
+
+
+// Accumulator policies for computeProduct(). Each provides the partial 'State', how to multiply a
+// factor into it, how to combine two partial states and how to turn the final state into a result.
+
+// Exact 64-bit product with overflow detection
+struct CheckedInt64Product
+{
+   using Value = std::int64_t;
+   struct State { std::int64_t product{ 1 }; bool overflow{ false }; bool zero{ false }; };
+
+   static void multiply( State& s, std::int64_t x ) noexcept
+   {
+      s.overflow |= __builtin_mul_overflow( s.product, x, &s.product );
+      s.zero |= ( x == 0 );
+   }
+
+   static State combine( State a, State const& b ) noexcept
+   {
+      multiply( a, b.product );
+      a.overflow |= b.overflow;
+      a.zero |= b.zero;
+      return a;
+   }
+
+   // A zero factor makes the product exact even if the partial products overflowed before
+   static ProductResult<Value> finish( State const& s ) noexcept
+   {
+      return s.zero ? ProductResult<Value>{ 0, false } : ProductResult<Value>{ s.product, s.overflow };
+   }
+};
+
+
+#if defined(__SIZEOF_INT128__)
+// Exact 128-bit product with overflow detection
+struct Int128Product
+{
+   using Value = __int128;
+   struct State { __int128 product{ 1 }; bool overflow{ false }; bool zero{ false }; };
+
+   static void multiply( State& s, __int128 x ) noexcept
+   {
+      s.overflow |= __builtin_mul_overflow( s.product, x, &s.product );
+      s.zero |= ( x == 0 );
+   }
+
+   static State combine( State a, State const& b ) noexcept
+   {
+      multiply( a, b.product );
+      a.overflow |= b.overflow;
+      a.zero |= b.zero;
+      return a;
+   }
+
+   static ProductResult<Value> finish( State const& s ) noexcept
+   {
+      return s.zero ? ProductResult<Value>{ 0, false } : ProductResult<Value>{ s.product, s.overflow };
+   }
+};
+#endif
+
+
+// Floating-point product; overflow is reported when the result is no longer finite
+struct DoubleProduct
+{
+   using Value = double;
+   struct State { double product{ 1.0 }; };
+
+   static void multiply( State& s, double x ) noexcept { s.product *= x; }
+   static State combine( State a, State const& b ) noexcept { a.product *= b.product; return a; }
+
+   static ProductResult<Value> finish( State const& s ) noexcept
+   {
+      return { s.product, !std::isfinite( s.product ) };
+   }
+};
+
+
+// Natural logarithm of the magnitude plus the sign of a product that would not fit any type
+struct LogMagnitude
+{
+   double log;  // -inf for a zero product
+   int sign;    // -1, 0 or +1
+};
+
+
+// Log-domain product that never overflows
+struct LogProduct
+{
+   using Value = LogMagnitude;
+   struct State { double log{ 0.0 }; bool negative{ false }; bool zero{ false }; };
+
+   static void multiply( State& s, double x ) noexcept
+   {
+      s.log += std::log( std::abs( x ) );
+      s.negative ^= ( x < 0.0 );
+      s.zero |= ( x == 0.0 );
+   }
+
+   static State combine( State a, State const& b ) noexcept
+   {
+      a.log += b.log;
+      a.negative ^= b.negative;
+      a.zero |= b.zero;
+      return a;
+   }
+
+   static ProductResult<Value> finish( State const& s ) noexcept
+   {
+      if( s.zero ) {
+         return { LogMagnitude{ -std::numeric_limits<double>::infinity(), 0 }, false };
+      }
+      return { LogMagnitude{ s.log, s.negative ? -1 : 1 }, false };
+   }
+};
+
+
+// Compile-time choices of the numeric kernels per element type: the product accumulator used by
+// default and, for the narrow integers, the type in which 'squareBlock' squares can be summed
+// without overflow. It is chosen as narrow as possible to keep many lanes per SIMD register.
+template< typename T >
+struct KernelTraits;
+
+template<>
+struct KernelTraits<std::int8_t>
+{
+   using Product = CheckedInt64Product;
+   using Square  = std::int32_t;  // Squares are at most 2^14
+   static constexpr std::size_t squareBlock = std::size_t{1} << 16;
+};
+
+template<>
+struct KernelTraits<std::int16_t>
+{
+   using Product = CheckedInt64Product;
+   using Square  = std::int64_t;  // Squares are at most 2^30
+   static constexpr std::size_t squareBlock = std::size_t{1} << 30;
+};
+
+template<>
+struct KernelTraits<std::int32_t>
+{
+   using Product = CheckedInt64Product;
+};
+
+template<>
+struct KernelTraits<float>
+{
+   using Product = DoubleProduct;
+};
+
+template<>
+struct KernelTraits<double>
+{
+   using Product = DoubleProduct;
+};
+
+
+// Number of independent accumulators per thread; breaks the serial dependency chain of a single
+// running product so that several multiplications (or SIMD lanes) are in flight at once
+constexpr std::size_t productAccumulators = 8U;
+
+// Below this many elements per thread the product is not worth spreading across threads
+constexpr std::size_t parallelProductChunk = std::size_t{1} << 18;
+
+
+template< typename Accumulator, typename T >
+typename Accumulator::State multiplyRange( T const* data, std::size_t first, std::size_t last )
+{
+   static_assert( std::is_integral<T>::value || !std::is_integral<typename Accumulator::Value>::value,
+                  "Integer product accumulators require integer elements" );
+   using State = typename Accumulator::State;
+
+   std::array<State,productAccumulators> states{};
+   std::size_t i = first;
+   for( ; i+productAccumulators<=last; i+=productAccumulators ) {
+      for( std::size_t k=0U; k<productAccumulators; ++k ) {
+         Accumulator::multiply( states[k], data[i+k] );
+      }
+   }
+   for( ; i<last; ++i ) {
+      Accumulator::multiply( states[0], data[i] );
+   }
+
+   for( std::size_t stride=1U; stride<productAccumulators; stride*=2U ) {
+      for( std::size_t k=0U; k+stride<productAccumulators; k+=2U*stride ) {
+         states[k] = Accumulator::combine( states[k], states[k+stride] );
+      }
+   }
+   return states[0];
+}
+
+
+// Product of all elements with a selectable accumulator, e.g. computeProduct<Int128Product>( ints )
+template< typename Accumulator, typename T >
+ProductResult<typename Accumulator::Value> computeProduct( std::vector<T> const& values, std::size_t threads = hardwareThreads() )
+{
+   T const* const data = values.data();
+   auto const state = parallelReduce( values.size(), parallelProductChunk,
+      [data]( std::size_t first, std::size_t last ){ return multiplyRange<Accumulator>( data, first, last ); },
+      []( auto const& a, auto const& b ){ return Accumulator::combine( a, b ); }, threads );
+   return Accumulator::finish( state );
+}
+
+
+// Product with the default accumulator of the element type, i.e. a 64-bit integer for integers
+template< typename T >
+auto computeProduct( std::vector<T> const& values )
+{
+    auto const result = computeProduct<typename KernelTraits<T>::Product>( values );
+    if( result.overflow ) {
+        throw std::overflow_error( "Product of all elements exceeds the range of the result type" );
+    }
+    return result.value;
+}
+
+
+// Predicate x <= bound. Besides the scalar call operator it offers a SIMD test of all 'lanes'
+// elements of a 128-bit register, which lets the filter engine compare and compact 16 int8, 8 int16
+// or 4 int/float values at once.
+template< typename T >
+struct LessEqual
+{
+   static constexpr std::size_t lanes = 16U / sizeof(T);
+
+   T bound;
+
+   bool operator()( T x ) const noexcept { return x <= bound; }
+
+#if defined(__SSE2__)
+   // Bit k of the result is set if the k-th of the values at 'values' satisfies the predicate. Only
+   // offered for floats and for integers of up to 32 bits, SSE2 has no 64-bit integer compare.
+   template< typename U = T, typename = std::enable_if_t< std::is_floating_point<U>::value || sizeof(U) <= 4U > >
+   int mask( T const* values ) const noexcept
+   {
+      if constexpr( std::is_same<T,float>::value ) {
+         return _mm_movemask_ps( _mm_cmple_ps( _mm_loadu_ps( values ), _mm_set1_ps( bound ) ) );
+      }
+      else if constexpr( std::is_same<T,double>::value ) {
+         return _mm_movemask_pd( _mm_cmple_pd( _mm_loadu_pd( values ), _mm_set1_pd( bound ) ) );
+      }
+      else {
+         __m128i v = _mm_loadu_si128( reinterpret_cast<__m128i const*>( values ) );
+         __m128i b = sizeof(T) == 1U ? _mm_set1_epi8( static_cast<char>( bound ) )
+                   : sizeof(T) == 2U ? _mm_set1_epi16( static_cast<short>( bound ) )
+                                     : _mm_set1_epi32( static_cast<int>( bound ) );
+         if constexpr( std::is_unsigned<T>::value ) {
+            // The signed compares order unsigned values once the sign bits of both sides are flipped
+            __m128i const sign = sizeof(T) == 1U ? _mm_set1_epi8( static_cast<char>( 0x80 ) )
+                               : sizeof(T) == 2U ? _mm_set1_epi16( static_cast<short>( 0x8000 ) )
+                                                 : _mm_set1_epi32( static_cast<int>( 0x80000000U ) );
+            v = _mm_xor_si128( v, sign );
+            b = _mm_xor_si128( b, sign );
+         }
+         if constexpr( sizeof(T) == 1U ) {
+            return _mm_movemask_epi8( _mm_cmpgt_epi8( v, b ) ) ^ 0xFFFF;
+         }
+         else if constexpr( sizeof(T) == 2U ) {
+            __m128i const greater = _mm_cmpgt_epi16( v, b );
+            return _mm_movemask_epi8( _mm_packs_epi16( greater, _mm_setzero_si128() ) ) ^ 0xFF;
+         }
+         else {
+            __m128i const greater = _mm_cmpgt_epi32( v, b );
+            return _mm_movemask_ps( _mm_castsi128_ps( greater ) ) ^ 0xF;
+         }
+      }
+   }
+#endif
+};
+
+template< typename T >
+LessEqual( T ) -> LessEqual<T>;
+
+
+// Detects predicates that provide the SIMD test for elements of type T
+template< typename Predicate, typename T, typename = void >
+struct HasSimdMask : std::false_type {};
+
+#if defined(__SSE2__)
+template< typename Predicate, typename T >
+struct HasSimdMask< Predicate, T, decltype( void( std::declval<Predicate const&>().mask( std::declval<T const*>() ) ) ) >
+   : std::bool_constant< Predicate::lanes * sizeof(T) == 16U > {};
+#endif
+
+
+std::size_t popcount( unsigned mask ) noexcept
+{
+#if defined(__GNUC__)
+   return static_cast<std::size_t>( __builtin_popcount( mask ) );
+#else
+   return std::bitset<32>( mask ).count();
+#endif
+}
+
+
+template< typename T, typename Predicate >
+std::size_t countMatches( T const* data, std::size_t n, Predicate p )
+{
+   std::size_t count = 0U;
+   std::size_t i = 0U;
+#if defined(__SSE2__)
+   if constexpr( HasSimdMask<Predicate,T>::value ) {
+      constexpr std::size_t lanes = Predicate::lanes;
+      for( ; i+lanes<=n; i+=lanes ) {
+         count += popcount( static_cast<unsigned>( p.mask( data + i ) ) );
+      }
+   }
+#endif
+   for( ; i<n; ++i ) {
+      count += p( data[i] );
+   }
+   return count;
+}
+
+
+#if defined(__SSSE3__)
+// Shuffle controls that move the selected lanes of a 4-lane mask to the front of the register
+struct CompressTable
+{
+   std::array<std::array<std::int8_t,16>,16> shuffles{};
+
+   constexpr CompressTable()
+   {
+      for( int mask=0; mask<16; ++mask ) {
+         int k = 0;
+         for( int lane=0; lane<4; ++lane ) {
+            if( mask & ( 1 << lane ) ) {
+               for( int byte=0; byte<4; ++byte ) {
+                  shuffles[mask][4*k + byte] = static_cast<std::int8_t>( 4*lane + byte );
+               }
+               ++k;
+            }
+         }
+      }
+   }
+};
+
+constexpr CompressTable compressTable{};
+#endif
+
+
+// Copies the matching elements of the n values at 'data' to 'out' in order. 'capacity' is the exact
+// number of matches: unconditional stores are only used while they cannot run past it, so several
+// threads can compact adjacent slices of one output buffer.
+template< typename T, typename Predicate >
+void compactMatches( T const* data, std::size_t n, T* out, std::size_t capacity, Predicate p )
+{
+   std::size_t k = 0U;
+   std::size_t i = 0U;
+#if defined(__SSE2__)
+   if constexpr( HasSimdMask<Predicate,T>::value ) {
+      constexpr std::size_t lanes = Predicate::lanes;
+      constexpr int all = ( 1 << lanes ) - 1;
+      for( ; i+lanes<=n && k+lanes<=capacity; i+=lanes ) {
+         __m128i const values = _mm_loadu_si128( reinterpret_cast<__m128i const*>( data + i ) );
+         int const mask = p.mask( data + i );
+#  if defined(__SSSE3__)
+         if constexpr( lanes == 4U ) {
+            // Compress-store: shuffle the selected lanes to the front and store all four
+            __m128i const shuffle = _mm_loadu_si128( reinterpret_cast<__m128i const*>( compressTable.shuffles[mask].data() ) );
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + k ), _mm_shuffle_epi8( values, shuffle ) );
+            k += popcount( static_cast<unsigned>( mask ) );
+            continue;
+         }
+#  endif
+         // Runs of rejected or accepted elements are skipped or copied a whole register at a time
+         if( mask == 0 ) continue;
+         if( mask == all ) {
+            _mm_storeu_si128( reinterpret_cast<__m128i*>( out + k ), values );
+            k += lanes;
+            continue;
+         }
+         for( std::size_t lane=0U; lane<lanes; ++lane ) {
+            out[k] = data[i+lane];
+            k += static_cast<std::size_t>( ( mask >> lane ) & 1 );
+         }
+      }
+   }
+#endif
+   for( ; i<n && k<capacity; ++i ) {
+      out[k] = data[i];
+      k += p( data[i] );
+   }
+   // The last match may be followed by a stretch of rejected elements; stay within 'capacity'
+   for( ; i<n; ++i ) {
+      if( p( data[i] ) ) {
+         out[k++] = data[i];
+      }
+   }
+}
+
+
+// Below this size the filter runs on the calling thread
+constexpr std::size_t parallelFilterChunk = std::size_t{1} << 18;
+
+
+// Stable filter with an exactly sized result. Large inputs are counted per chunk in parallel, the
+// counts are turned into output offsets by a prefix sum, and every chunk compacts into its slice.
+template< typename T, typename Predicate >
+std::vector<T> filterInts( std::vector<T> const& values, Predicate p, std::size_t threads = hardwareThreads() )
+{
+   std::size_t const n = values.size();
+   std::size_t const chunks = std::max<std::size_t>( 1U, std::min( threads, n / parallelFilterChunk ) );
+   auto const chunkBegin = [n,chunks]( std::size_t c ){ return n * c / chunks; };
+
+   std::vector<std::size_t> offsets( chunks + 1U );
+   parallelFor( chunks, 1U, [&]( std::size_t first, std::size_t last ) {
+      for( std::size_t c=first; c<last; ++c ) {
+         offsets[c+1U] = countMatches( values.data() + chunkBegin(c), chunkBegin(c+1U) - chunkBegin(c), p );
+      }
+   }, threads );
+   std::partial_sum( std::begin(offsets), std::end(offsets), std::begin(offsets) );
+
+   std::vector<T> result( offsets.back() );
+   parallelFor( chunks, 1U, [&]( std::size_t first, std::size_t last ) {
+      for( std::size_t c=first; c<last; ++c ) {
+         compactMatches( values.data() + chunkBegin(c), chunkBegin(c+1U) - chunkBegin(c),
+                         result.data() + offsets[c], offsets[c+1U] - offsets[c], p );
+      }
+   }, threads );
+   return result;
 }
 
 
 Ints extractInts( Ints const& ints )
 {
-    Ints to_vector;
-    std::copy_if(std::begin(ints), std::end(ints), std::back_inserter(to_vector), [](int x){return x <= 5;});
-    return to_vector;
+    return filterInts( ints, LessEqual{ 5 } );
 }
 
 
-double computeLength( Ints const& ints )
+// Summation strategies for computeLength()
+enum class NormMode
+{
+   exact,        // Integer squares accumulated exactly and rounded once at the end; floating-point
+                 // squares (exact in double for float) accumulated with compensation
+   fast,         // Squares accumulated in several independent double accumulators
+   compensated   // Neumaier (improved Kahan) summation of the double squares
+};
+
+
+// Number of independent accumulators per pass; enough to hide the add latency and to fill
+// the SIMD lanes when the compiler vectorizes the loop
+constexpr std::size_t normAccumulators = 8U;
+
+// Below this many elements per thread computeLength() does not start another thread
+constexpr std::size_t parallelNormChunk = std::size_t{1} << 18;
+
+
+// Exact sum of integer squares as the two 64-bit halves of a 128-bit number
+struct WideSum
 {
-    Ints d = ints;
-    std::for_each(d.begin(), d.end(), [](int& x) { x = x * x; });
-    double p = std::sqrt(std::accumulate(d.begin(), d.end(), 0));
-    return p;
+   std::uint64_t low{ 0U };
+   std::uint64_t high{ 0U };
+
+   WideSum& operator+=( WideSum const& other ) noexcept
+   {
+      low += other.low;
+      high += other.high + ( low < other.low );
+      return *this;
+   }
+
+   double value() const noexcept
+   {
+      return std::ldexp( static_cast<double>( high ), 64 ) + static_cast<double>( low );
+   }
+};
+
+
+// Neumaier (improved Kahan) sum: the rounded sum plus the separately accumulated rounding errors
+struct CompensatedSum
+{
+   double sum{ 0.0 };
+   double compensation{ 0.0 };
+
+   CompensatedSum& operator+=( double x ) noexcept
+   {
+      double const t = sum + x;
+      compensation += std::abs( sum ) >= std::abs( x ) ? ( sum - t ) + x : ( x - t ) + sum;
+      sum = t;
+      return *this;
+   }
+
+   CompensatedSum& operator+=( CompensatedSum const& other ) noexcept
+   {
+      *this += other.sum;
+      compensation += other.compensation;
+      return *this;
+   }
+
+   double value() const noexcept { return sum + compensation; }
+};
+
+
+// Exact sum of squares of 8 or 16 bit integers: the squares are summed in the narrow integer type of
+// KernelTraits, which packs more lanes per register than 64-bit sums, and every 'squareBlock'
+// elements the partial sums are moved into a 128-bit total
+template< typename T >
+WideSum sumOfSquaresWidened( T const* data, std::size_t n ) noexcept
+{
+   using Square = typename KernelTraits<T>::Square;
+   constexpr std::size_t block = KernelTraits<T>::squareBlock;
+
+   WideSum total;
+   for( std::size_t first=0U; first<n; first+=std::min( block, n - first ) )
+   {
+      std::size_t const last = first + std::min( block, n - first );
+      std::array<Square,normAccumulators> sums{};
+      std::size_t i = first;
+      for( ; i+normAccumulators<=last; i+=normAccumulators ) {
+         for( std::size_t k=0U; k<normAccumulators; ++k ) {
+            Square const x = data[i+k];
+            sums[k] += x * x;
+         }
+      }
+      for( ; i<last; ++i ) {
+         Square const x = data[i];
+         sums[0] += x * x;
+      }
+
+      total += WideSum{ static_cast<std::uint64_t>( std::accumulate( std::begin(sums), std::end(sums), std::int64_t{0} ) ), 0U };
+   }
+   return total;
+}
+
+
+WideSum sumOfSquaresExact( std::int32_t const* data, std::size_t n ) noexcept
+{
+   // Every square fits into 62 bits, so a carry counter per accumulator keeps the sum exact
+   std::array<std::uint64_t,normAccumulators> low{};
+   std::array<std::uint64_t,normAccumulators> high{};
+   std::size_t i = 0U;
+   for( ; i+normAccumulators<=n; i+=normAccumulators ) {
+      for( std::size_t k=0U; k<normAccumulators; ++k ) {
+         std::int64_t const x = data[i+k];
+         std::uint64_t const square = static_cast<std::uint64_t>( x * x );
+         low[k] += square;
+         high[k] += ( low[k] < square );
+      }
+   }
+   for( ; i<n; ++i ) {
+      std::int64_t const x = data[i];
+      std::uint64_t const square = static_cast<std::uint64_t>( x * x );
+      low[0] += square;
+      high[0] += ( low[0] < square );
+   }
+
+   WideSum sum;
+   for( std::size_t k=0U; k<normAccumulators; ++k ) {
+      sum += WideSum{ low[k], high[k] };
+   }
+   return sum;
+}
+
+
+template< typename T >
+double sumOfSquaresFast( T const* data, std::size_t n ) noexcept
+{
+   std::array<double,normAccumulators> sums{};
+   std::size_t i = 0U;
+   for( ; i+normAccumulators<=n; i+=normAccumulators ) {
+      for( std::size_t k=0U; k<normAccumulators; ++k ) {
+         double const x = data[i+k];
+         sums[k] += x * x;
+      }
+   }
+   for( ; i<n; ++i ) {
+      double const x = data[i];
+      sums[0] += x * x;
+   }
+   return std::accumulate( std::begin(sums), std::end(sums), 0.0 );
+}
+
+
+template< typename T >
+CompensatedSum sumOfSquaresCompensated( T const* data, std::size_t n ) noexcept
+{
+   CompensatedSum sum;
+   for( std::size_t i=0U; i<n; ++i ) {
+      double const x = data[i];
+      sum += x * x;
+   }
+   return sum;
+}
+
+
+// Euclidean length in a single pass over the input, without copying it. Large inputs may be spread
+// across threads; the result is bitwise identical for every thread count (see parallelReduce()).
+template< typename T >
+double computeLength( std::vector<T> const& values, NormMode mode = NormMode::exact, std::size_t threads = 1U )
+{
+    T const* const data = values.data();
+    auto const sumOfSquares = [&]( auto kernel ) {
+       return parallelReduce( values.size(), parallelNormChunk,
+          [data,kernel]( std::size_t first, std::size_t last ){ return kernel( data + first, last - first ); },
+          []( auto a, auto const& b ){ return a += b; }, threads );
+    };
+    auto const compensated = [&]{
+       return sumOfSquares( []( T const* p, std::size_t n ){ return sumOfSquaresCompensated( p, n ); } ).value();
+    };
+
+    switch( mode ) {
+       case NormMode::fast:        return std::sqrt( sumOfSquares( []( T const* p, std::size_t n ){ return sumOfSquaresFast( p, n ); } ) );
+       case NormMode::compensated: return std::sqrt( compensated() );
+       case NormMode::exact:       break;
+    }
+    if constexpr( std::is_floating_point<T>::value ) {
+       return std::sqrt( compensated() );
+    }
+    else if constexpr( sizeof(T) < sizeof(std::int32_t) ) {
+       return std::sqrt( sumOfSquares( []( T const* p, std::size_t n ){ return sumOfSquaresWidened( p, n ); } ).value() );
+    }
+    else {
+       return std::sqrt( sumOfSquares( []( T const* p, std::size_t n ){ return sumOfSquaresExact( p, n ); } ).value() );
+    }
+}
+
+
+// L1, L2 and maximum norms of every row of a row-major matrix
+struct RowNorms
+{
+   Doubles l1;
+   Doubles l2;
+   Doubles linf;
+};
+
+
+// Rows up to this length are processed in tiles that are transposed into a local buffer, so that
+// the inner loop runs across rows with unit stride and vectorizes even for very short rows
+constexpr std::size_t shortRowLength = 32U;
+constexpr std::size_t rowTile        = 16U;
+
+// Fewer rows than this per thread do not pay for starting a thread
+constexpr std::size_t parallelRowChunk = 4096U;
+
+
+void computeShortRowNorms( int const* matrix, std::size_t columns, std::size_t first, std::size_t last, RowNorms& norms )
+{
+   // L1 sums of at most shortRowLength absolute ints stay below 2^37 and are exact in double precision;
+   // the squares summed for L2 reach 2^62 and are rounded, as in computeLongRowNorms()
+   std::array<double,shortRowLength*rowTile> tile{};
+   for( std::size_t row=first; row<last; row+=rowTile )
+   {
+      std::size_t const rows = std::min( rowTile, last - row );
+
+      // Transpose the tile of absolute values; missing rows of the last tile are zero-padded
+      int const* const block = matrix + row*columns;
+      if( rows < rowTile ) {
+         tile.fill( 0.0 );
+      }
+      for( std::size_t r=0U; r<rows; ++r ) {
+         for( std::size_t c=0U; c<columns; ++c ) {
+            tile[c*rowTile + r] = static_cast<double>( block[r*columns + c] );
+         }
+      }
+
+      std::array<double,rowTile> l1{};
+      std::array<double,rowTile> l2{};
+      std::array<double,rowTile> linf{};
+      for( std::size_t c=0U; c<columns; ++c ) {
+         double const* const column = tile.data() + c*rowTile;
+         for( std::size_t r=0U; r<rowTile; ++r ) {
+            double const a = std::abs( column[r] );
+            l1[r] += a;
+            l2[r] += a * a;
+            linf[r] = std::max( linf[r], a );
+         }
+      }
+
+      for( std::size_t r=0U; r<rows; ++r ) {
+         norms.l1[row+r]   = l1[r];
+         norms.l2[row+r]   = std::sqrt( l2[r] );
+         norms.linf[row+r] = linf[r];
+      }
+   }
+}
+
+
+void computeLongRowNorms( int const* matrix, std::size_t columns, std::size_t first, std::size_t last, RowNorms& norms )
+{
+   for( std::size_t row=first; row<last; ++row )
+   {
+      int const* const values = matrix + row*columns;
+      std::array<std::int64_t,normAccumulators> l1{};
+      std::array<double,normAccumulators> l2{};
+      std::array<std::int64_t,normAccumulators> linf{};
+      std::size_t c = 0U;
+      for( ; c+normAccumulators<=columns; c+=normAccumulators ) {
+         for( std::size_t k=0U; k<normAccumulators; ++k ) {
+            std::int64_t const a = std::abs( std::int64_t{ values[c+k] } );
+            double const x = static_cast<double>( a );
+            l1[k] += a;
+            l2[k] += x * x;
+            linf[k] = std::max( linf[k], a );
+         }
+      }
+      for( ; c<columns; ++c ) {
+         std::int64_t const a = std::abs( std::int64_t{ values[c] } );
+         double const x = static_cast<double>( a );
+         l1[0] += a;
+         l2[0] += x * x;
+         linf[0] = std::max( linf[0], a );
+      }
+
+      norms.l1[row]   = static_cast<double>( std::accumulate( std::begin(l1), std::end(l1), std::int64_t{0} ) );
+      norms.l2[row]   = std::sqrt( std::accumulate( std::begin(l2), std::end(l2), 0.0 ) );
+      norms.linf[row] = static_cast<double>( *std::max_element( std::begin(linf), std::end(linf) ) );
+   }
 }
 
 
-Doubles computeRatios( Ints const& ints )
+// Norms of all rows of the row-major matrix stored in 'matrix', optionally spread across threads
+RowNorms computeRowNorms( Ints const& matrix, std::size_t columns, std::size_t threads = 1U )
 {
-    // ints.size() - 1U calculates the size of the ints collection minus 1 and casts it to an unsigned integer (U).
-    // 0.0 initializes all elements of the ratios object to 0.0. It seems like ratios is a collection of doubles.
-    Doubles ratios(ints.size() - 1U, 0.0);
-    std::transform(std::begin(ints) + 1U, std::end(ints),
-                   std::begin(ints),
-                   std::begin(ratios),
-                   [](double liczebnik, double mianownik){return liczebnik/mianownik;});
+   std::size_t const rows = columns > 0U ? matrix.size() / columns : 0U;
+   RowNorms norms{ Doubles( rows ), Doubles( rows ), Doubles( rows ) };
+
+   parallelFor( rows, parallelRowChunk, [&]( std::size_t first, std::size_t last ) {
+      if( columns <= shortRowLength ) {
+         computeShortRowNorms( matrix.data(), columns, first, last, norms );
+      }
+      else {
+         computeLongRowNorms( matrix.data(), columns, first, last, norms );
+      }
+   }, threads );
+
+   return norms;
+}
+
+
+// How computeRatios() divides: exactly, or by multiplying with a reciprocal estimate refined by one
+// Newton-Raphson step (about 23 correct bits, i.e. single precision)
+enum class DivisionMode { exact, reciprocal };
+
+
+// What computeRatios() stores for a zero denominator: the IEEE result (inf or nan), or a fixed value
+struct ZeroDenominatorPolicy
+{
+   bool substitute{ false };
+   double value{ 0.0 };
+};
+
+
+#if defined(__SSE2__)
+// Four consecutive elements as two pairs of doubles and as four floats for the reciprocal. Narrow
+// integers are sign-extended to 32 bits in registers, so only 4 or 8 bytes are read per group.
+struct FourValues
+{
+   __m128d low;
+   __m128d high;
+   __m128 single;
+};
+
+FourValues convertFour( __m128i values ) noexcept
+{
+   return { _mm_cvtepi32_pd( values ), _mm_cvtepi32_pd( _mm_shuffle_epi32( values, 0xEE ) ), _mm_cvtepi32_ps( values ) };
+}
+
+FourValues loadFour( std::int8_t const* p ) noexcept
+{
+   std::int32_t bytes;
+   std::memcpy( &bytes, p, sizeof(bytes) );
+   __m128i const v = _mm_cvtsi32_si128( bytes );
+   __m128i const w = _mm_unpacklo_epi8( v, v );
+   return convertFour( _mm_srai_epi32( _mm_unpacklo_epi16( w, w ), 24 ) );
+}
+
+FourValues loadFour( std::int16_t const* p ) noexcept
+{
+   __m128i const v = _mm_loadl_epi64( reinterpret_cast<__m128i const*>( p ) );
+   return convertFour( _mm_srai_epi32( _mm_unpacklo_epi16( v, v ), 16 ) );
+}
+
+FourValues loadFour( std::int32_t const* p ) noexcept
+{
+   return convertFour( _mm_loadu_si128( reinterpret_cast<__m128i const*>( p ) ) );
+}
+
+FourValues loadFour( float const* p ) noexcept
+{
+   __m128 const v = _mm_loadu_ps( p );
+   return { _mm_cvtps_pd( v ), _mm_cvtps_pd( _mm_movehl_ps( v, v ) ), v };
+}
+#endif
+
+
+// The reciprocal of DivisionMode::reciprocal: the hardware estimate refined by one Newton-Raphson
+// step. The SIMD loop and the scalar tail share it, so a ratio does not depend on whether it lands
+// in a SIMD lane or in the tail. A zero denominator keeps the estimate, which is the IEEE 1/0 = +-inf
+// (the refinement would turn it into nan).
+#if defined(__SSE2__)
+__m128 refinedReciprocal( __m128 d ) noexcept
+{
+   __m128 const estimate = _mm_rcp_ps( d );
+   __m128 const refined = _mm_mul_ps( estimate, _mm_sub_ps( _mm_set1_ps( 2.0f ), _mm_mul_ps( d, estimate ) ) );
+   __m128 const zero = _mm_cmpeq_ps( d, _mm_setzero_ps() );
+   return _mm_or_ps( _mm_and_ps( zero, estimate ), _mm_andnot_ps( zero, refined ) );
+}
+#endif
+
+float refinedReciprocal( float d ) noexcept
+{
+#if defined(__SSE2__)
+   return _mm_cvtss_f32( refinedReciprocal( _mm_set_ss( d ) ) );
+#else
+   return 1.0f / d;
+#endif
+}
+
+
+// Writes the ratios v[i+1]/v[i] of the n values at 'values' into 'out', which must have room for
+// n-1 elements. Zero denominators are handled by masking the whole result, not by a branch per
+// element. Element types of up to 32 bits go through the 4-wide SIMD loop.
+template< typename T >
+void computeRatios( T const* values, std::size_t n, double* out,
+                    DivisionMode mode = DivisionMode::exact, ZeroDenominatorPolicy policy = {} )
+{
+   if( n < 2U ) return;
+   std::size_t const count = n - 1U;
+   std::size_t i = 0U;
+
+#if defined(__SSE2__)
+   if constexpr( sizeof(T) <= 4U ) {
+      __m128d const substitute = _mm_set1_pd( policy.value );
+      __m128d const useSubstitute = _mm_castsi128_pd( _mm_set1_epi32( policy.substitute ? -1 : 0 ) );
+      auto store = [&]( double* dst, __m128d quotient, __m128d denominator ) {
+         __m128d const mask = _mm_and_pd( _mm_cmpeq_pd( denominator, _mm_setzero_pd() ), useSubstitute );
+         _mm_storeu_pd( dst, _mm_or_pd( _mm_andnot_pd( mask, quotient ), _mm_and_pd( mask, substitute ) ) );
+      };
+
+      for( ; i+4U<=count; i+=4U ) {
+         FourValues const den = loadFour( values + i );
+         FourValues const num = loadFour( values + i + 1U );
+
+         if( mode == DivisionMode::reciprocal ) {
+            __m128 const r = refinedReciprocal( den.single );
+            store( out + i,      _mm_mul_pd( num.low,  _mm_cvtps_pd( r ) ),                   den.low );
+            store( out + i + 2U, _mm_mul_pd( num.high, _mm_cvtps_pd( _mm_movehl_ps( r, r ) ) ), den.high );
+         }
+         else {
+            store( out + i,      _mm_div_pd( num.low,  den.low ),  den.low );
+            store( out + i + 2U, _mm_div_pd( num.high, den.high ), den.high );
+         }
+      }
+   }
+#endif
+
+   for( ; i<count; ++i ) {
+      double const denominator = values[i];
+      double const quotient = mode == DivisionMode::reciprocal
+                            ? values[i+1U] * static_cast<double>( refinedReciprocal( static_cast<float>( denominator ) ) )
+                            : values[i+1U] / denominator;
+      out[i] = ( policy.substitute && denominator == 0.0 ) ? policy.value : quotient;
+   }
+}
+
+
+template< typename T >
+Doubles computeRatios( std::vector<T> const& values )
+{
+    Doubles ratios( values.size() > 1U ? values.size() - 1U : 0U );
+    computeRatios( values.data(), values.size(), ratios.data() );
     return ratios;
 }
 
 
+// Streaming counterparts of computeProduct(), computeLength() and computeRatios() for inputs that
+// arrive in chunks of arbitrary size, e.g. from a socket or a file, and may be of any length. Each
+// reducer keeps a constant amount of state and its finalize() gives the result that the batch
+// function would give for the concatenation of all chunks pushed so far, bitwise also for the
+// floating-point reductions. StreamingRatios has nothing to finalize: push() writes the ratio
+// v[i+1]/v[i] as soon as its numerator v[i+1] arrives, keeping the last value of each chunk as the
+// denominator of the next ratio, and computes it as computeRatios() does, so the ratios match
+// bitwise as well.
+
+// Cuts a stream into the blocks of parallelReduce(). Complete blocks inside a chunk are handed on
+// where they lie; only a block that straddles two chunks is assembled in the internal buffer.
+template< typename T >
+class BlockBuffer
+{
+ public:
+   // Calls 'block(data,size)' for every block completed by the n values at 'data'
+   template< typename Block >
+   void push( T const* data, std::size_t n, Block block )
+   {
+      if( size_ > 0U ) {
+         std::size_t const take = std::min( n, reductionBlock - size_ );
+         std::copy_n( data, take, buffer_.data() + size_ );
+         size_ += take;
+         data += take;
+         n -= take;
+         if( size_ < reductionBlock ) return;
+         block( buffer_.data(), reductionBlock );
+         size_ = 0U;
+      }
+      for( ; n >= reductionBlock; data += reductionBlock, n -= reductionBlock ) {
+         block( data, reductionBlock );
+      }
+      std::copy_n( data, n, buffer_.data() );
+      size_ = n;
+   }
+
+   T const* data() const noexcept { return buffer_.data(); }
+   std::size_t size() const noexcept { return size_; }
+
+ private:
+   std::vector<T> buffer_ = std::vector<T>( reductionBlock );
+   std::size_t size_{ 0U };  // Elements of the incomplete current block
+};
+
+
+// Reduces a stream block by block with 'Reduce(data,size)' and 'Combine(a,b)'
+template< typename T, typename Reduce, typename Combine >
+class StreamReducer
+{
+ public:
+   using Result = std::invoke_result_t<Reduce const&, T const*, std::size_t>;
+
+   explicit StreamReducer( Reduce reduce = Reduce(), Combine combine = Combine() )
+      : reduce_( reduce ), tree_( combine ) {}
+
+   void push( T const* data, std::size_t n )
+   {
+      buffer_.push( data, n, [this]( T const* block, std::size_t size ){ tree_.push( reduce_( block, size ) ); } );
+   }
+
+   // An empty stream is a single empty block, like an empty range in parallelReduce()
+   Result finalize() const
+   {
+      if( tree_.empty() ) {
+         return reduce_( buffer_.data(), buffer_.size() );
+      }
+      if( buffer_.size() == 0U ) {
+         return tree_.result();
+      }
+      auto tree = tree_;
+      tree.push( reduce_( buffer_.data(), buffer_.size() ) );
+      return tree.result();
+   }
+
+ private:
+   Reduce reduce_;
+   BlockBuffer<T> buffer_;
+   PairwiseTree<Result,Combine> tree_;
+};
+
+
+template< typename T, typename Accumulator >
+struct MultiplyBlock
+{
+   typename Accumulator::State operator()( T const* data, std::size_t n ) const
+   {
+      return multiplyRange<Accumulator>( data, 0U, n );
+   }
+};
+
+template< typename Accumulator >
+struct CombineProducts
+{
+   typename Accumulator::State operator()( typename Accumulator::State const& a, typename Accumulator::State const& b ) const
+   {
+      return Accumulator::combine( a, b );
+   }
+};
+
+
+// Running product with overflow flag; finalize() matches computeProduct<Accumulator>()
+template< typename T, typename Accumulator = typename KernelTraits<T>::Product >
+class StreamingProduct
+{
+ public:
+   void push( T const* data, std::size_t n ) { reducer_.push( data, n ); }
+
+   ProductResult<typename Accumulator::Value> finalize() const { return Accumulator::finish( reducer_.finalize() ); }
+
+ private:
+   StreamReducer< T, MultiplyBlock<T,Accumulator>, CombineProducts<Accumulator> > reducer_;
+};
+
+
+// Running sum of squares; finalize() matches computeLength() with the same mode
+template< typename T >
+class StreamingLength
+{
+ public:
+   explicit StreamingLength( NormMode mode = NormMode::exact )
+      : reducer_( makeReducer( mode ) ) {}
+
+   void push( T const* data, std::size_t n )
+   {
+      std::visit( [data,n]( auto& reducer ){ reducer.push( data, n ); }, reducer_ );
+   }
+
+   double finalize() const
+   {
+      return std::visit( []( auto const& reducer ) {
+         auto const sum = reducer.finalize();
+         if constexpr( std::is_same<decltype(sum),double const>::value ) {
+            return std::sqrt( sum );
+         }
+         else {
+            return std::sqrt( sum.value() );
+         }
+      }, reducer_ );
+   }
+
+ private:
+   struct Fast        { double operator()( T const* p, std::size_t n ) const { return sumOfSquaresFast( p, n ); } };
+   struct Compensated { CompensatedSum operator()( T const* p, std::size_t n ) const { return sumOfSquaresCompensated( p, n ); } };
+   struct Widened     { WideSum operator()( T const* p, std::size_t n ) const { return sumOfSquaresWidened( p, n ); } };
+   struct Exact32     { WideSum operator()( T const* p, std::size_t n ) const { return sumOfSquaresExact( p, n ); } };
+   struct Add         { template< typename S > S operator()( S a, S const& b ) const { return a += b; } };
+
+   // The kernel of NormMode::exact, chosen as in computeLength()
+   using Exact = std::conditional_t< std::is_floating_point<T>::value, Compensated,
+                                     std::conditional_t< ( sizeof(T) < sizeof(std::int32_t) ), Widened, Exact32 > >;
+
+   using Reducer = std::variant< StreamReducer<T,Fast,Add>, StreamReducer<T,Compensated,Add>, StreamReducer<T,Exact,Add> >;
+
+   static Reducer makeReducer( NormMode mode )
+   {
+      switch( mode ) {
+         case NormMode::fast:        return Reducer( std::in_place_index<0> );
+         case NormMode::compensated: return Reducer( std::in_place_index<1> );
+         case NormMode::exact:       break;
+      }
+      return Reducer( std::in_place_index<2> );
+   }
+
+   Reducer reducer_;
+};
+
+
+// Ratios of consecutive values across chunk boundaries; only the last value is carried over
+template< typename T >
+class StreamingRatios
+{
+ public:
+   explicit StreamingRatios( DivisionMode mode = DivisionMode::exact, ZeroDenominatorPolicy policy = {} )
+      : mode_( mode ), policy_( policy ) {}
+
+   // Writes the ratios completed by the n values at 'data' to 'out', which needs room for n of them.
+   // Returns the number of ratios written: n, or n-1 for the first non-empty chunk.
+   std::size_t push( T const* data, std::size_t n, double* out )
+   {
+      if( n == 0U ) return 0U;
+      std::size_t written = 0U;
+      if( started_ ) {
+         T const pair[2] = { last_, data[0] };
+         computeRatios( pair, 2U, out, mode_, policy_ );
+         written = 1U;
+      }
+      computeRatios( data, n, out + written, mode_, policy_ );
+      last_ = data[n-1U];
+      started_ = true;
+      return written + n - 1U;
+   }
+
+ private:
+   DivisionMode mode_;
+   ZeroDenominatorPolicy policy_;
+   T last_{};
+   bool started_{ false };
+};
+
+
+// Number of values and their extremes; 'min' and 'max' are only meaningful if 'count' is non-zero
+template< typename T >
+struct StreamSummary
+{
+   std::uint64_t count;
+   T min;
+   T max;
+};
+
+template< typename T >
+class StreamingSummary
+{
+ public:
+   void push( T const* data, std::size_t n )
+   {
+      if( n == 0U ) return;
+      auto const extremes = std::minmax_element( data, data + n );
+      summary_.min = std::min( summary_.min, *extremes.first );
+      summary_.max = std::max( summary_.max, *extremes.second );
+      summary_.count += n;
+   }
+
+   StreamSummary<T> finalize() const { return summary_; }
+
+ private:
+   StreamSummary<T> summary_{ 0U, std::numeric_limits<T>::max(), std::numeric_limits<T>::lowest() };
+};
+
+
+// Rotation by block swaps (Gries-Mills): the shorter block is repeatedly swapped into its final
+// position with std::swap_ranges, so every step streams through memory sequentially regardless
+// of the strategy of the standard library's std::rotate (some follow GCD cycles and jump around
+// large buffers). Returns the new position of *first, like std::rotate.
+template< typename RandomIt >
+RandomIt blockSwapRotate( RandomIt first, RandomIt middle, RandomIt last )
+{
+   if( first == middle ) return last;
+   if( middle == last ) return first;
+
+   RandomIt const result = first + ( last - middle );
+   while( first != middle && middle != last )
+   {
+      auto const left  = middle - first;
+      auto const right = last - middle;
+      if( left <= right ) {
+         // [A B1 B2] -> [B1 A B2]; B1 is final, continue with [A B2]
+         std::swap_ranges( first, middle, middle );
+         first = middle;
+         middle += left;
+      }
+      else {
+         // [A1 A2 B] -> [A1 B A2]; A2 is final, continue with [A1 B]
+         std::swap_ranges( middle - right, middle, middle );
+         last = middle;
+         middle -= right;
+      }
+   }
+   return result;
+}
+
+
+// Moves the range [first,last) in place so that it starts (if pos < first) or ends (if pos > last)
+// at 'pos'. Returns the new location of the moved range.
+template< typename RandomIt >
+std::pair<RandomIt,RandomIt> slide( RandomIt first, RandomIt last, RandomIt pos )
+{
+   if( pos < first ) return { pos, blockSwapRotate( pos, first, last ) };
+   if( last < pos )  return { blockSwapRotate( first, last, pos ), pos };
+   return { first, last };
+}
+
+
+// Gathers all elements satisfying 'p' around 'pos' without changing the relative order of the
+// gathered or of the remaining elements. Returns the range of gathered elements.
+template< typename BidirIt, typename Predicate >
+std::pair<BidirIt,BidirIt> gather( BidirIt first, BidirIt last, BidirIt pos, Predicate p )
+{
+   return { std::stable_partition( first, pos, [&p]( auto const& x ){ return !p( x ); } ),
+            std::stable_partition( pos, last, p ) };
+}
+
+
+// In-place variant of moveRange() for buffers too large to copy
+void moveRangeInPlace( Ints& ints )
+{
+    if( ints.size() > 3U ) {
+        slide(std::begin(ints) + 3U, std::end(ints), std::begin(ints));
+    }
+}
+
+
 Ints moveRange( Ints const& ints )
 {
     Ints result (ints);
-    std::rotate(std::begin(result), std::begin(result) + 3U, std::end(result));
+    moveRangeInPlace(result);
 //    std::move(std::begin(ints) + 3U, std::end(ints) + 4U, std::begin(result));
     return result;
 }
 
 
+// Lazy pipelines over the STLpro operations, e.g.
+//
+//    from( ints ) | filter( LessEqual{5} ) | adjacent( ratio ) | reduce( 1.0, std::multiplies<>() )
+//
+// Stages only record what to do. The terminal reduce() stage nests them into a single chain of
+// inlined sinks and runs one loop over the input, so no intermediate Ints/Doubles are created;
+// at most a filter's small block buffer is live at any time.
+
+// Matching values are collected with branch-free stores into a small cache-resident block that is
+// handed downstream whenever it fills up, so the data-dependent branch of the predicate turns into
+// a well-predicted block-full check
+template< typename Predicate, typename T, typename Sink >
+struct FilterSink
+{
+   static constexpr std::size_t blockSize = 256U;
+
+   Predicate predicate;
+   Sink sink;
+   std::array<T,blockSize> block{};
+   std::size_t size{ 0U };
+
+   void operator()( T const& value )
+   {
+      block[size] = value;
+      size += predicate( value );
+      if( size == blockSize ) {
+         drain();
+      }
+   }
+
+   void finish()
+   {
+      drain();
+      sink.finish();
+   }
+
+   void drain()
+   {
+      for( std::size_t i=0U; i<size; ++i ) {
+         sink( block[i] );
+      }
+      size = 0U;
+   }
+};
+
+template< typename Function, typename Sink >
+struct TransformSink
+{
+   Function function;
+   Sink sink;
+
+   template< typename T >
+   void operator()( T const& value ) { sink( function( value ) ); }
+
+   void finish() { sink.finish(); }
+};
+
+// Emits function(previous,current) for every pair of consecutive values
+template< typename Function, typename T, typename Sink >
+struct AdjacentSink
+{
+   Function function;
+   Sink sink;
+   T previous{};
+   bool started{ false };
+
+   void operator()( T const& value )
+   {
+      if( started ) {
+         sink( function( previous, value ) );
+      }
+      previous = value;
+      started = true;
+   }
+
+   void finish() { sink.finish(); }
+};
+
+template< typename T, typename Operation >
+struct ReduceSink
+{
+   T* accumulator;
+   Operation operation;
+
+   template< typename U >
+   void operator()( U const& value ) { *accumulator = operation( *accumulator, value ); }
+
+   void finish() {}
+};
+
+
+template< typename Predicate >
+struct FilterStage
+{
+   Predicate predicate;
+
+   template< typename In, typename Sink >
+   auto wrap( Sink sink ) const { return FilterSink<Predicate,In,Sink>{ predicate, sink }; }
+
+   template< typename In >
+   using Out = In;
+};
+
+template< typename Function >
+struct TransformStage
+{
+   Function function;
+
+   template< typename In, typename Sink >
+   auto wrap( Sink sink ) const { return TransformSink<Function,Sink>{ function, sink }; }
+
+   template< typename In >
+   using Out = std::decay_t< std::invoke_result_t<Function const&, In const&> >;
+};
+
+template< typename Function >
+struct AdjacentStage
+{
+   Function function;
+
+   template< typename In, typename Sink >
+   auto wrap( Sink sink ) const { return AdjacentSink<Function,In,Sink>{ function, sink }; }
+
+   template< typename In >
+   using Out = std::decay_t< std::invoke_result_t<Function const&, In const&, In const&> >;
+};
+
+template< typename T, typename Operation >
+struct ReduceStage
+{
+   T initial;
+   Operation operation;
+};
+
+
+template< typename Predicate >
+FilterStage<Predicate> filter( Predicate predicate ) { return { predicate }; }
+
+template< typename Function >
+TransformStage<Function> transform( Function function ) { return { function }; }
+
+template< typename Function >
+AdjacentStage<Function> adjacent( Function function ) { return { function }; }
+
+template< typename T, typename Operation >
+ReduceStage<T,Operation> reduce( T initial, Operation operation ) { return { initial, operation }; }
+
+
+template< typename Range, typename... Stages >
+struct Pipeline
+{
+   Range const& range;
+   std::tuple<Stages...> stages;
+};
+
+template< typename Range >
+Pipeline<Range> from( Range const& range ) { return { range, {} }; }
+
+
+template< typename Range, typename... Stages, typename Stage >
+Pipeline<Range,Stages...,Stage> operator|( Pipeline<Range,Stages...> const& pipeline, Stage const& stage )
+{
+   return { pipeline.range, std::tuple_cat( pipeline.stages, std::make_tuple( stage ) ) };
+}
+
+
+// Value type flowing into stage I
+template< typename In, std::size_t I, typename Tuple >
+struct StageInput
+{
+   using PreviousStage = std::tuple_element_t<I-1U,Tuple>;
+   using type = typename PreviousStage::template Out< typename StageInput<In,I-1U,Tuple>::type >;
+};
+
+template< typename In, typename Tuple >
+struct StageInput<In,0U,Tuple>
+{
+   using type = In;
+};
+
+
+// Wraps 'sink' into stages I-1, ..., 0 so that the outermost sink accepts the input elements
+template< typename In, std::size_t I, typename Tuple, typename Sink >
+auto buildSink( Tuple const& stages, Sink sink )
+{
+   if constexpr( I == 0U ) {
+      return sink;
+   }
+   else {
+      using StageIn = typename StageInput<In,I-1U,Tuple>::type;
+      return buildSink<In,I-1U>( stages, std::get<I-1U>( stages ).template wrap<StageIn>( sink ) );
+   }
+}
+
+
+template< typename Range, typename... Stages, typename T, typename Operation >
+T operator|( Pipeline<Range,Stages...> const& pipeline, ReduceStage<T,Operation> const& stage )
+{
+   using In = std::decay_t< decltype( *std::begin( pipeline.range ) ) >;
+
+   T accumulator = stage.initial;
+   auto sink = buildSink<In,sizeof...(Stages)>( pipeline.stages, ReduceSink<T,Operation>{ &accumulator, stage.operation } );
+   for( auto const& value : pipeline.range ) {
+      sink( value );
+   }
+   sink.finish();
+   return accumulator;
+}
+
+
 int main()
 {
     Ints ints{ 1, 5, 2, 8, 7, 10, 4 };
@@ -91,7 +1560,7 @@ int main()
     // Compute the product of all elements in v
     {
         std::cout << " Product of all elements: expected = 22400, actual = ";
-        int const product = computeProduct( ints );
+        std::int64_t const product = computeProduct( ints );
         std::cout << product << "\n";
     }
 
@@ -116,6 +1585,46 @@ int main()
         std::cout << "\n";
     }
 
+    // Compute the product of the ratios of all numbers <= 5 in a single fused pass
+    {
+        std::cout << " Product of ratios of values <= 5: expected = 4, actual = ";
+        double const product = from( ints ) | filter( LessEqual{ 5 } )
+                                            | adjacent( []( int a, int b ){ return static_cast<double>( b ) / a; } )
+                                            | reduce( 1.0, std::multiplies<>() );
+        std::cout << product << "\n";
+    }
+
+    // Feed a million values in chunks that straddle the reduction blocks and compare with the batch results
+    {
+        std::cout << " Streamed product and lengths equal the batch results: expected = 1, actual = ";
+        Ints signs( 1000000U, 1 );
+        Ints values( 1000000U );
+        for( std::size_t i = 0U; i < values.size(); ++i ) {
+           signs[i] = i % 5U == 0U ? -1 : 1;
+           values[i] = static_cast<int>( i * 7919U % 2001U ) - 1000;
+        }
+        signs[12345] = 7;
+
+        StreamingProduct<int> product;
+        StreamingLength<int> lengths[] = { StreamingLength<int>( NormMode::fast ), StreamingLength<int>( NormMode::compensated ), StreamingLength<int>( NormMode::exact ) };
+        for( std::size_t first = 0U; first < values.size(); first += 100003U ) {
+           std::size_t const n = std::min<std::size_t>( 100003U, values.size() - first );
+           product.push( signs.data() + first, n );
+           for( auto& length : lengths ) {
+              length.push( values.data() + first, n );
+           }
+        }
+
+        auto const streamed = product.finalize();
+        auto const batch = computeProduct<KernelTraits<int>::Product>( signs );
+        bool equal = streamed.value == batch.value && streamed.overflow == batch.overflow;
+        NormMode const modes[] = { NormMode::fast, NormMode::compensated, NormMode::exact };
+        for( std::size_t m = 0U; m < 3U; ++m ) {
+           equal = equal && lengths[m].finalize() == computeLength( values, modes[m] );
+        }
+        std::cout << equal << "\n";
+    }
+
     // Move the range [v[3],v[5]] to the beginning of the vector
     {
         std::cout << " Moved range: expected = ( 8 7 10 4 1 5 2 ), actual = ";
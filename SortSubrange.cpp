@@ -18,29 +18,491 @@
 **************************************************************************************************/
 
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstddef>
 #include <cstdlib>
+#include <functional>
+#include <future>
 #include <iostream>
+#include <iterator>
+#include <map>
+#include <random>
+#include <thread>
+#include <utility>
 #include <vector>
 
 
-// TODO: Implement the 'sort_subrange()' algorithm
+// Ranges up to this size are left to std::nth_element; above it Floyd-Rivest sampling pays off
+constexpr std::ptrdiff_t floyd_rivest_cutoff = 600;
+
+
+// Selection by Floyd and Rivest: like std::nth_element, but the pivot is first selected within a
+// small block around position nth, so that it lands right next to the sought element and a single
+// partition step usually leaves only a few sqrt(n) candidates. On average this needs about
+// n + min(k, n-k) comparisons, where plain introselect needs two to three times n. Rounds that
+// make too little progress (adversarial orders) fall back to std::nth_element.
+template<typename Iterator, typename Compare>
+void floyd_rivest_select(Iterator first, Iterator last, Iterator nth, Compare comp)
+{
+    using Diff = typename std::iterator_traits<Iterator>::difference_type;
+
+    if (nth == last) return;
+    Diff left = 0;
+    Diff right = (last - first) - 1;
+    Diff const k = nth - first;
+
+    int rounds = 0;
+    for (Diff n = last - first; n > 1; n /= 2) rounds += 2;
+
+    while (right > left)
+    {
+        if (right - left < floyd_rivest_cutoff || rounds-- == 0)
+        {
+            std::nth_element(first + left, nth, first + right + 1, comp);
+            return;
+        }
+
+        // Place the k-th element of a block of about n^(2/3) elements around k first
+        double const n = static_cast<double>(right - left + 1);
+        double const i = static_cast<double>(k - left + 1);
+        double const z = std::log(n);
+        double const s = 0.5 * std::exp(2.0 * z / 3.0);
+        double const sd = 0.5 * std::sqrt(z * s * (n - s) / n) * (i < n / 2.0 ? -1.0 : 1.0);
+        Diff const sample_left  = std::max(left,  static_cast<Diff>(static_cast<double>(k) - i * s / n + sd));
+        Diff const sample_right = std::min(right, static_cast<Diff>(static_cast<double>(k) + (n - i) * s / n + sd));
+        floyd_rivest_select(first + sample_left, first + sample_right + 1, nth, comp);
+
+        // Hoare partition of [left,right] around that element
+        auto const pivot = first[k];
+        Diff lo = left;
+        Diff hi = right;
+        std::iter_swap(first + left, first + k);
+        if (comp(pivot, first[right])) std::iter_swap(first + left, first + right);
+        while (lo < hi)
+        {
+            std::iter_swap(first + lo, first + hi);
+            ++lo;
+            --hi;
+            while (comp(first[lo], pivot)) ++lo;
+            while (comp(pivot, first[hi])) --hi;
+        }
+        if (!comp(first[left], pivot) && !comp(pivot, first[left]))
+        {
+            std::iter_swap(first + left, first + hi);
+        }
+        else
+        {
+            ++hi;
+            std::iter_swap(first + hi, first + right);
+        }
+
+        // The pivot is now final at hi; continue on the side that holds k
+        if (hi <= k) left = hi + 1;
+        if (k <= hi) right = hi - 1;
+    }
+}
+
+
+// Unsorted segments up to this size are sorted outright instead of being partitioned further
+constexpr std::size_t sorted_view_cutoff = 32;
+
+
+// Lazily sorted view of [first,last) for showing pages of a sorted order on demand (incremental
+// quicksort). The range is cut into segments that already hold the elements of their positions in
+// the sorted order. A request partitions only the segments containing its boundaries, around random
+// pivots, and keeps every pivot as a segment boundary, so later requests start from smaller
+// segments. The first page costs O(n) and a walk over all pages O(n log n) in total. The elements
+// of the underlying range are reordered in place.
+template<typename Iterator, typename Compare = std::less<>>
+class sorted_view
+{
+public:
+    sorted_view(Iterator first, Iterator last, Compare comp = Compare())
+        : first_(first), size_(static_cast<std::size_t>(last - first)), comp_(comp)
+    {
+        segments_.emplace(0, size_ <= 1);
+    }
+
+    std::size_t size() const { return size_; }
+
+    // Puts the positions [begin,end) of the sorted order into place and returns them
+    std::pair<Iterator, Iterator> range(std::size_t begin, std::size_t end)
+    {
+        // An empty request leaves the range untouched
+        if (begin >= end) return { at(begin), at(begin) };
+
+        // An untouched view has no pivots to reuse yet: place both boundaries directly by selection
+        if (segments_.size() == 1 && !segments_.begin()->second)
+        {
+            if (begin > 0) floyd_rivest_select(at(0), at(size_), at(begin), comp_);
+            if (end < size_) floyd_rivest_select(at(begin > 0 ? begin + 1 : begin), at(size_), at(end), comp_);
+            std::sort(at(begin), at(end), comp_);
+            segments_.emplace(begin, true).first->second = true;
+            if (end < size_) segments_.emplace(end, false);
+            return { at(begin), at(end) };
+        }
+
+        split(begin);
+        split(end);
+        for (auto it = segments_.find(begin); it != segments_.end() && it->first < end; ++it)
+        {
+            if (!it->second)
+            {
+                std::sort(at(it->first), at(segment_end(it)), comp_);
+                it->second = true;
+            }
+        }
+        return { at(begin), at(end) };
+    }
+
+    // The element at position i of the sorted order
+    typename std::iterator_traits<Iterator>::reference operator[](std::size_t i)
+    {
+        return *range(i, i + 1).first;
+    }
+
+private:
+    // Segment starts mapped to whether the segment is sorted; a segment ends where the next begins
+    using Segments = std::map<std::size_t, bool>;
+
+    Iterator at(std::size_t i) const
+    {
+        return first_ + static_cast<typename std::iterator_traits<Iterator>::difference_type>(i);
+    }
+
+    std::size_t segment_end(typename Segments::const_iterator it) const
+    {
+        auto const next = std::next(it);
+        return next == segments_.end() ? size_ : next->first;
+    }
+
+    // Makes position p a segment boundary
+    void split(std::size_t p)
+    {
+        while (p < size_)
+        {
+            auto const it = std::prev(segments_.upper_bound(p));
+            std::size_t const l = it->first;
+            std::size_t const r = segment_end(it);
+            if (l == p) return;
+            if (!it->second && r - l <= sorted_view_cutoff)
+            {
+                std::sort(at(l), at(r), comp_);
+                it->second = true;
+            }
+            if (it->second)
+            {
+                segments_.emplace(p, true);
+                return;
+            }
+
+            // Partition around the median of three random elements, which ends up final at m
+            std::uniform_int_distribution<std::size_t> position(l, r - 1);
+            Iterator a = at(position(random_));
+            Iterator b = at(position(random_));
+            Iterator const c = at(position(random_));
+            if (comp_(*b, *a)) std::swap(a, b);
+            if (comp_(*c, *b))
+            {
+                b = c;
+                if (comp_(*b, *a)) b = a;
+            }
+            std::iter_swap(b, at(r - 1));
+            auto const& pivot = *at(r - 1);
+            Iterator const middle = std::partition(at(l), at(r - 1), [&](auto const& x) { return comp_(x, pivot); });
+            std::iter_swap(middle, at(r - 1));
+            std::size_t const m = static_cast<std::size_t>(middle - first_);
+
+            if (m > l)
+            {
+                segments_.emplace(m, true);
+                if (m + 1 < r) segments_.emplace(m + 1, false);
+            }
+            else
+            {
+                // Nothing is below the pivot: split off all elements equivalent to it at once, so
+                // that runs of duplicates cannot degrade the partitioning to quadratic time
+                Iterator const greater = std::partition(std::next(middle), at(r), [&](auto const& x) { return !comp_(*middle, x); });
+                std::size_t const g = static_cast<std::size_t>(greater - first_);
+                it->second = true;
+                if (g < r) segments_.emplace(g, false);
+            }
+        }
+    }
+
+    Iterator first_;
+    std::size_t size_;
+    Compare comp_;
+    Segments segments_;
+    std::minstd_rand random_;
+};
+
+
+// Selects both boundaries of the subrange and sorts only the elements in between, which costs
+// O(n + k log k) for a window of k elements, whereas partial_sort over the whole tail would cost
+// O(n log k)
 template<typename Iterator, typename unary>
 void sort_subrange(Iterator first, Iterator last, Iterator range_start, Iterator range_end, unary p)
 {
     // Check if range is nonzero
     if (range_start == range_end) return;
-    // Check if sub range begins at the beginning
-    if (first != range_start)
+    // A single request to a fresh sorted view
+    sorted_view<Iterator, unary>(first, last, p).range(static_cast<std::size_t>(range_start - first),
+                                                      static_cast<std::size_t>(range_end - first));
+}
+template<typename Iterator>
+void sort_subrange(Iterator first, Iterator last, Iterator range_start, Iterator range_end)
+{
+    sort_subrange(first, last, range_start, range_end, std::less<>());
+}
+
+
+// Places the elements belonging at all positions [nth_first,nth_last) (sorted iterators into
+// [first,last)) and partitions the range between them: the middle position is selected first and
+// splits both the range and the positions, so m positions cost O(n log m) instead of O(m n)
+template<typename Iterator, typename PositionIt, typename Compare>
+void multi_select(Iterator first, Iterator last, PositionIt nth_first, PositionIt nth_last, Compare comp)
+{
+    while (nth_first != nth_last)
+    {
+        PositionIt const middle = nth_first + (nth_last - nth_first) / 2;
+        floyd_rivest_select(first, last, *middle, comp);
+        multi_select(first, *middle, nth_first, middle, comp);
+        first = std::next(*middle);
+        nth_first = std::next(middle);
+    }
+}
+
+
+// Sorts several disjoint subranges of [first,last) at once. All window boundaries are placed by a
+// single multi_select() pass, after which every window holds exactly its elements and is sorted
+// on its own.
+template<typename Iterator, typename Compare>
+void sort_subranges(Iterator first, Iterator last, std::vector<std::pair<Iterator, Iterator>> const& ranges, Compare comp)
+{
+    std::vector<Iterator> boundaries;
+    for (auto const& range : ranges)
     {
-        std::nth_element(first, range_start, last, p);
+        if (range.first == range.second) continue;
+        if (range.first != first) boundaries.push_back(range.first);
+        if (range.second != last) boundaries.push_back(range.second);
     }
-    std::partial_sort(range_start, range_end, last, p);
+    std::sort(boundaries.begin(), boundaries.end());
+    boundaries.erase(std::unique(boundaries.begin(), boundaries.end()), boundaries.end());
+
+    multi_select(first, last, boundaries.begin(), boundaries.end(), comp);
 
+    for (auto const& range : ranges)
+    {
+        std::sort(range.first, range.second, comp);
+    }
 }
 template<typename Iterator>
-void sort_subrange(Iterator first, Iterator last, Iterator range_start, Iterator range_end)
+void sort_subranges(Iterator first, Iterator last, std::vector<std::pair<Iterator, Iterator>> const& ranges)
 {
-    sort_subrange(first, last, range_start, range_end, std::less<>());
+    sort_subranges(first, last, ranges, std::less<>());
+}
+
+
+// Runs body(chunk, begin, end) for 'chunks' equal index chunks of [0,n), one per thread
+template<typename Body>
+void parallel_chunks(std::size_t n, std::size_t chunks, Body body)
+{
+    std::vector<std::future<void>> futures;
+    for (std::size_t c = 1; c < chunks; ++c)
+    {
+        futures.push_back(std::async(std::launch::async, body, c, n * c / chunks, n * (c + 1) / chunks));
+    }
+    body(std::size_t{0}, std::size_t{0}, n / chunks);
+    for (auto& f : futures) f.get();
+}
+
+
+// Below this many elements per thread the selection and sorting steps run sequentially
+constexpr std::size_t parallel_subrange_chunk = std::size_t{1} << 16;
+
+
+// Parallel variant of floyd_rivest_select(). Every round draws an evenly spaced sample, picks two
+// pivots from it that bracket the rank of nth, and partitions the range into the three buckets
+// below, between and above them: every thread counts its chunk, a prefix sum over the counts gives
+// each chunk its slots, and the chunks are scattered into a buffer in parallel and moved back. The
+// bucket holding nth is usually a small fraction of the range, so after one or two rounds the rest
+// is left to the sequential selection.
+template<typename Iterator, typename Compare>
+void parallel_select(Iterator first, Iterator last, Iterator nth, Compare comp, std::size_t threads)
+{
+    using Value = typename std::iterator_traits<Iterator>::value_type;
+
+    if (nth == last) return;
+    std::vector<Value> buffer;
+    while (static_cast<std::size_t>(last - first) >= 2 * parallel_subrange_chunk && threads > 1)
+    {
+        std::size_t const n = static_cast<std::size_t>(last - first);
+        std::size_t const k = static_cast<std::size_t>(nth - first);
+        std::size_t const chunks = std::min(threads, n / parallel_subrange_chunk);
+
+        // Pivots about two standard deviations of the sample rank around the rank of nth
+        std::size_t const samples = static_cast<std::size_t>(std::sqrt(static_cast<double>(n)));
+        std::vector<Value> sample;
+        sample.reserve(samples);
+        for (std::size_t i = 0; i < samples; ++i) sample.push_back(first[i * (n / samples)]);
+        std::sort(sample.begin(), sample.end(), comp);
+        std::size_t const rank = k * samples / n;
+        std::size_t const spread = static_cast<std::size_t>(2.0 * std::sqrt(static_cast<double>(samples)));
+        Value const low  = sample[rank > spread ? rank - spread : 0];
+        Value const high = sample[std::min(samples - 1, rank + spread)];
+
+        // 0: below low, 1: between low and high, 2: above high
+        auto const bucket = [&](Value const& x) { return comp(x, low) ? 0 : comp(high, x) ? 2 : 1; };
+
+        std::vector<std::array<std::size_t, 3>> counts(chunks);
+        parallel_chunks(n, chunks, [&](std::size_t c, std::size_t begin, std::size_t end) {
+            std::array<std::size_t, 3> count{};
+            for (std::size_t i = begin; i < end; ++i) ++count[bucket(first[i])];
+            counts[c] = count;
+        });
+
+        std::array<std::size_t, 4> bounds{};
+        for (int b = 0; b < 3; ++b)
+        {
+            bounds[b + 1] = bounds[b];
+            for (auto const& count : counts) bounds[b + 1] += count[b];
+        }
+        std::vector<std::array<std::size_t, 3>> offsets(chunks);
+        for (int b = 0; b < 3; ++b)
+        {
+            std::size_t offset = bounds[b];
+            for (std::size_t c = 0; c < chunks; ++c)
+            {
+                offsets[c][b] = offset;
+                offset += counts[c][b];
+            }
+        }
+
+        buffer.resize(n);
+        parallel_chunks(n, chunks, [&](std::size_t c, std::size_t begin, std::size_t end) {
+            std::array<std::size_t, 3> offset = offsets[c];
+            for (std::size_t i = begin; i < end; ++i) buffer[offset[bucket(first[i])]++] = std::move(first[i]);
+        });
+        parallel_chunks(n, chunks, [&](std::size_t, std::size_t begin, std::size_t end) {
+            std::move(buffer.begin() + begin, buffer.begin() + end, first + begin);
+        });
+
+        // Continue in the bucket of nth; a middle bucket of equivalent elements is already done
+        std::size_t const b = k < bounds[1] ? 0 : k < bounds[2] ? 1 : 2;
+        if (b == 1 && !comp(low, high)) return;
+        if (bounds[b + 1] - bounds[b] == n) break;
+        last = first + bounds[b + 1];
+        first = first + bounds[b];
+    }
+    floyd_rivest_select(first, last, nth, comp);
+}
+
+
+// Merge path: returns how many of the first 'diag' elements of the merge of [a,a+na) and [b,b+nb)
+// come from a, so that a merge can be cut into independent pieces at any output position
+template<typename Iterator1, typename Iterator2, typename Compare>
+std::size_t merge_path_split(Iterator1 a, std::size_t na, Iterator2 b, std::size_t nb, std::size_t diag, Compare comp)
+{
+    std::size_t lo = diag > nb ? diag - nb : 0;
+    std::size_t hi = std::min(diag, na);
+    while (lo < hi)
+    {
+        std::size_t const mid = lo + (hi - lo) / 2;
+        if (comp(b[diag - mid - 1], a[mid])) hi = mid;
+        else lo = mid + 1;
+    }
+    return lo;
+}
+
+
+// Sorts [first,last) with 'threads' threads: the chunks are sorted concurrently and then merged
+// pairwise between the range and a buffer. Every merge is cut with merge path into pieces of about
+// n/threads elements, so all threads stay busy up to the last level, which merges the whole range.
+template<typename Iterator, typename Compare>
+void parallel_sort(Iterator first, Iterator last, Compare comp, std::size_t threads)
+{
+    using Value = typename std::iterator_traits<Iterator>::value_type;
+    using Diff = typename std::iterator_traits<Iterator>::difference_type;
+
+    std::size_t const n = static_cast<std::size_t>(last - first);
+    std::size_t const chunks = std::max<std::size_t>(1, std::min(threads, n / parallel_subrange_chunk));
+    auto const bound = [&](std::size_t c) { return n * std::min(c, chunks) / chunks; };
+
+    parallel_chunks(chunks, chunks, [&](std::size_t c, std::size_t, std::size_t) {
+        std::sort(first + static_cast<Diff>(bound(c)), first + static_cast<Diff>(bound(c + 1)), comp);
+    });
+    if (chunks == 1) return;
+
+    // A piece of a merge: the runs [begin,middle) and [middle,end), output positions [from,to) of it,
+    // and where [from,to) starts and ends in the first run
+    struct piece { std::size_t begin, middle, end, from, to, a0, a1; };
+
+    std::vector<Value> buffer(n);
+    bool in_buffer = false;
+    for (std::size_t width = 1; width < chunks; width *= 2)
+    {
+        std::vector<piece> pieces;
+        for (std::size_t c = 0; c < chunks; c += 2 * width)
+        {
+            std::size_t const begin = bound(c);
+            std::size_t const middle = bound(c + width);
+            std::size_t const end = bound(c + 2 * width);
+            std::size_t const parts = std::max<std::size_t>(1, threads * (end - begin) / n);
+            for (std::size_t p = 0; p < parts; ++p)
+            {
+                pieces.push_back({ begin, middle, end, (end - begin) * p / parts, (end - begin) * (p + 1) / parts, 0, 0 });
+            }
+        }
+
+        auto const merge_level = [&](auto src, auto dst) {
+            // All splits are found before any piece moves its elements out of src
+            for (piece& p : pieces)
+            {
+                auto const a = src + static_cast<Diff>(p.begin);
+                auto const b = src + static_cast<Diff>(p.middle);
+                p.a0 = merge_path_split(a, p.middle - p.begin, b, p.end - p.middle, p.from, comp);
+                p.a1 = merge_path_split(a, p.middle - p.begin, b, p.end - p.middle, p.to, comp);
+            }
+            parallel_chunks(pieces.size(), pieces.size(), [&](std::size_t i, std::size_t, std::size_t) {
+                piece const& p = pieces[i];
+                auto const a = src + static_cast<Diff>(p.begin);
+                auto const b = src + static_cast<Diff>(p.middle);
+                std::merge(std::make_move_iterator(a + static_cast<Diff>(p.a0)), std::make_move_iterator(a + static_cast<Diff>(p.a1)),
+                           std::make_move_iterator(b + static_cast<Diff>(p.from - p.a0)), std::make_move_iterator(b + static_cast<Diff>(p.to - p.a1)),
+                           dst + static_cast<Diff>(p.begin + p.from), comp);
+            });
+        };
+        if (in_buffer) merge_level(buffer.begin(), first);
+        else merge_level(first, buffer.begin());
+        in_buffer = !in_buffer;
+    }
+
+    if (in_buffer)
+    {
+        parallel_chunks(n, chunks, [&](std::size_t, std::size_t begin, std::size_t end) {
+            std::move(buffer.begin() + static_cast<Diff>(begin), buffer.begin() + static_cast<Diff>(end), first + static_cast<Diff>(begin));
+        });
+    }
+}
+
+
+// sort_subrange() with the selection and the sorting of the window spread across 'threads' threads
+template<typename Iterator, typename Compare>
+void parallel_sort_subrange(Iterator first, Iterator last, Iterator range_start, Iterator range_end, Compare comp,
+                            std::size_t threads = std::max(1u, std::thread::hardware_concurrency()))
+{
+    if (range_start == range_end) return;
+    if (first != range_start)
+    {
+        parallel_select(first, last, range_start, comp, threads);
+    }
+    if (range_end != last)
+    {
+        parallel_select(first != range_start ? std::next(range_start) : range_start, last, range_end, comp, threads);
+    }
+    parallel_sort(range_start, range_end, comp, threads);
 }
 
 int main()
@@ -64,6 +526,22 @@ int main()
        std::cout << ' ' << i;
     std::cout << " )\n\n";
 
+    // Sort the subranges [begin,begin+3) and [begin+8,end) within the range [begin,end) in ascending order at once
+    sort_subranges( v.begin(), v.end(), { { v.begin(), v.begin()+3 }, { v.begin()+8, v.end() } } );
+
+    std::cout << "\n (";
+    for( int i : v )
+       std::cout << ' ' << i;
+    std::cout << " )\n\n";
+
+    // Sort the subrange [begin+4,begin+8) within the range [begin,end) in descending order with two threads
+    parallel_sort_subrange( v.begin(), v.end(), v.begin()+4, v.begin()+8, std::greater<>(), 2 );
+
+    std::cout << "\n (";
+    for( int i : v )
+       std::cout << ' ' << i;
+    std::cout << " )\n\n";
+
 
     return EXIT_SUCCESS;
 }
\ No newline at end of file